@@ -0,0 +1,65 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#ifndef KERNEL_RING_H
+#define KERNEL_RING_H
+
+#include "kernel/types.h"
+
+/*
+A submission ring lets a process queue many small object operations
+in its own memory and have the kernel carry them all out with a
+single syscall_ring_enter, rather than trapping once per operation.
+
+The process fills in entries of sq and advances sq_tail; the kernel
+consumes them in order, advancing sq_head, and posts one completion
+per entry to cq, advancing cq_tail.  The process consumes completions
+by advancing cq_head.  The indexes run freely and are reduced modulo
+entries, which must be a power of two.  The kernel stops early if
+the completion queue fills up.
+*/
+
+typedef enum {
+	KERNEL_RING_NOP,
+	KERNEL_RING_READ,
+	KERNEL_RING_WRITE,
+	KERNEL_RING_OPEN,
+	KERNEL_RING_CLOSE,
+} kernel_ring_op_t;
+
+#define KERNEL_RING_MAX_ENTRIES 4096
+
+/*
+For READ and WRITE, addr and length give the buffer, and flags are
+kernel_io_flags_t.  For OPEN, fd is the directory, addr the path, and
+flags kernel_flags_t; the result is the new descriptor.
+*/
+
+struct kernel_ring_sqe {
+	int opcode;
+	int fd;
+	uint32_t addr;
+	int length;
+	int flags;
+	uint32_t user_data;
+};
+
+struct kernel_ring_cqe {
+	uint32_t user_data;
+	int result;
+};
+
+struct kernel_ring {
+	volatile uint32_t sq_head;
+	volatile uint32_t sq_tail;
+	volatile uint32_t cq_head;
+	volatile uint32_t cq_tail;
+	uint32_t entries;
+	struct kernel_ring_sqe *sq;
+	struct kernel_ring_cqe *cq;
+};
+
+#endif
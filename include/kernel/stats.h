@@ -6,6 +6,9 @@
 
 struct system_stats {
 	int time;
+	int idle_time;
+	int cpu_utilization;
+	int cpu_count;
 	int blocks_read[4];
 	int blocks_written[4];
 };
@@ -23,12 +26,103 @@ struct bcache_stats {
 	int writebacks;
 };
 
+/*
+Every kmalloc and page allocation is charged to one of these
+subsystems, so that memory growth can be traced to its owner.
+MEMORY_TAG_KMALLOC covers the pages that back the kmalloc heap
+itself, which are further broken down by the kmalloc counters.
+*/
+
+typedef enum {
+	MEMORY_TAG_OTHER,
+	MEMORY_TAG_KMALLOC,
+	MEMORY_TAG_PROCESS,
+	MEMORY_TAG_PAGETABLE,
+	MEMORY_TAG_USER,
+	MEMORY_TAG_BCACHE,
+	MEMORY_TAG_PIPE,
+	MEMORY_TAG_GRAPHICS,
+	MEMORY_TAG_FS,
+	MEMORY_TAG_MAX
+} memory_tag_t;
+
+struct memory_stats {
+	int pages_free;
+	int pages_total;
+	int pages[MEMORY_TAG_MAX];
+	int pages_peak[MEMORY_TAG_MAX];
+	int kmalloc_bytes[MEMORY_TAG_MAX];
+	int kmalloc_peak[MEMORY_TAG_MAX];
+	int kmalloc_count[MEMORY_TAG_MAX];
+};
+
+#define MEMORY_TRACE_KMALLOC 0
+#define MEMORY_TRACE_PAGE    1
+
+struct memory_trace {
+	uint32_t site;
+	uint32_t addr;
+	int length;
+	int tag;
+	int source;
+};
+
+/*
+wait_histogram[i] counts the times a process waited less than
+10^(i+1) microseconds to run after becoming ready, except that
+the last bucket counts everything longer.
+*/
+
+#define PROCESS_WAIT_BUCKETS 6
+
 struct process_stats {
 	int blocks_read;
 	int blocks_written;
 	int bytes_read;
 	int bytes_written;
+	int vm_data_size;
+	int vm_stack_size;
+	int resident_pages;
+	int run_time;
+	int user_time;
+	int kernel_time;
+	int wait_time;
+	int wait_histogram[PROCESS_WAIT_BUCKETS];
+	int voluntary_switches;
+	int involuntary_switches;
+	int nice;
 	int syscall_count[MAX_SYSCALL];
+	int syscall_time[MAX_SYSCALL];
+};
+
+/*
+System-wide latency of each system call, measured from entry
+to return, including any time spent blocked.  histogram[0]
+counts calls under one microsecond, histogram[i] those under
+2^i microseconds, and the last bucket everything longer.
+time_us wraps after about 71 minutes of total time in the call.
+*/
+
+#define SYSCALL_LATENCY_BUCKETS 16
+
+struct syscall_stats {
+	uint32_t count;
+	uint32_t time_us;
+	uint32_t min_ns;
+	uint32_t max_ns;
+	uint32_t histogram[SYSCALL_LATENCY_BUCKETS];
+};
+
+/*
+One completed system call, as read from the systrace device.
+*/
+
+struct syscall_trace {
+	uint32_t pid;
+	uint32_t syscall;
+	uint32_t args[5];
+	int32_t result;
+	uint32_t nanos;
 };
 
 #endif
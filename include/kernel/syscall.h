@@ -26,28 +26,45 @@ typedef enum {
 	SYSCALL_PROCESS_SLEEP,
 	SYSCALL_PROCESS_STATS,
 	SYSCALL_PROCESS_HEAP,
+	SYSCALL_PROCESS_NICE,
+	SYSCALL_THREAD_CREATE,
+	SYSCALL_THREAD_EXIT,
+	SYSCALL_THREAD_JOIN,
+	SYSCALL_FUTEX_WAIT,
+	SYSCALL_FUTEX_WAKE,
 	SYSCALL_OPEN_FILE,
 	SYSCALL_OPEN_DIR,
 	SYSCALL_OPEN_WINDOW,
 	SYSCALL_OPEN_CONSOLE,
 	SYSCALL_OPEN_PIPE,
+	SYSCALL_OPEN_SHMEM,
+	SYSCALL_OPEN_SYSTRACE,
 	SYSCALL_OBJECT_TYPE,
 	SYSCALL_OBJECT_COPY,
+	SYSCALL_OBJECT_TRANSFER,
 	SYSCALL_OBJECT_READ,
 	SYSCALL_OBJECT_LIST,
 	SYSCALL_OBJECT_WRITE,
 	SYSCALL_OBJECT_SEEK,
 	SYSCALL_OBJECT_SIZE,
+	SYSCALL_OBJECT_RESIZE,
 	SYSCALL_OBJECT_REMOVE,
 	SYSCALL_OBJECT_CLOSE,
 	SYSCALL_OBJECT_STATS,
 	SYSCALL_OBJECT_SET_TAG,
 	SYSCALL_OBJECT_GET_TAG,
 	SYSCALL_OBJECT_MAX,
+	SYSCALL_OBJECT_ADDRESS,
+	SYSCALL_OBJECT_POLL,
+	SYSCALL_RING_ENTER,
 	SYSCALL_SYSTEM_STATS,
 	SYSCALL_BCACHE_STATS,
 	SYSCALL_BCACHE_FLUSH,
+	SYSCALL_MEMORY_STATS,
+	SYSCALL_MEMORY_TRACE,
+	SYSCALL_SYSCALL_STATS,
 	SYSCALL_SYSTEM_TIME,
+	SYSCALL_SYSTEM_NANOS,
 	SYSCALL_SYSTEM_RTC,
 	SYSCALL_DEVICE_DRIVER_STATS,
 	MAX_SYSCALL		// must be the last element in the enum
@@ -55,4 +72,8 @@ typedef enum {
 
 uint32_t syscall(syscall_t s, uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e);
 
+/* The two entry paths behind syscall(), for measuring one against the other. */
+uint32_t syscall_trap(syscall_t s, uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e);
+uint32_t syscall_sysenter(syscall_t s, uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e);
+
 #endif
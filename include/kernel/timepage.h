@@ -0,0 +1,54 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#ifndef KERNEL_TIMEPAGE_H
+#define KERNEL_TIMEPAGE_H
+
+#include "kernel/types.h"
+
+/*
+The kernel maps one read-only page at TIME_PAGE_ADDRESS into every
+process, describing how to turn the processor timestamp counter into
+nanoseconds since boot, so that reading the time needs no syscall.
+This must agree with PROCESS_TIME_PAGE in kernel/memorylayout.h.
+*/
+
+#define TIME_PAGE_ADDRESS 0xeffff000
+
+/* Nanoseconds are ((tsc - tsc_base) * tsc_mult) >> TIME_PAGE_SHIFT */
+#define TIME_PAGE_SHIFT 24
+
+struct time_page {
+	uint32_t tsc_valid;
+	uint32_t tsc_mult;
+	uint64_t tsc_base;
+};
+
+static inline uint64_t time_page_rdtsc()
+{
+	uint32_t lo, hi;
+	asm volatile ("rdtsc":"=a"(lo), "=d"(hi));
+	return ((uint64_t) hi << 32) | lo;
+}
+
+/*
+Scale a count of cycles by a 32-bit multiplier without
+overflowing or needing 64-bit division.
+*/
+
+static inline uint64_t time_page_scale(uint64_t cycles, uint32_t mult)
+{
+	uint64_t lo = (cycles & 0xffffffff) * mult;
+	uint64_t hi = (cycles >> 32) * mult;
+	return (lo >> TIME_PAGE_SHIFT) + (hi << (32 - TIME_PAGE_SHIFT));
+}
+
+static inline uint64_t time_page_nanos(const struct time_page *t)
+{
+	return time_page_scale(time_page_rdtsc() - t->tsc_base, t->tsc_mult);
+}
+
+#endif
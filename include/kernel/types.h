@@ -51,7 +51,8 @@ typedef enum {
 	KOBJECT_DEVICE,
 	KOBJECT_WINDOW,
 	KOBJECT_PIPE,
-	KOBJECT_CONSOLE
+	KOBJECT_CONSOLE,
+	KOBJECT_SHMEM
 } kobject_type_t;
 
 typedef enum {
@@ -68,6 +69,24 @@ typedef enum {
 	KERNEL_IO_DIRECT=4,
 } kernel_io_flags_t;
 
+typedef enum {
+	KERNEL_POLL_READ=1,
+	KERNEL_POLL_WRITE=2,
+	KERNEL_POLL_INVALID=4,
+} kernel_poll_flags_t;
+
+/*
+One entry of the set given to syscall_object_poll: the caller fills
+in fd and events, and the kernel fills in revents with those events
+that are ready, or KERNEL_POLL_INVALID if fd is not an open object.
+*/
+
+struct kernel_poll {
+	int fd;
+	int events;
+	int revents;
+};
+
 #define KNO_STDIN   0
 #define KNO_STDOUT  1
 #define KNO_STDERR  2
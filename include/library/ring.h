@@ -0,0 +1,32 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#ifndef LIBRARY_RING_H
+#define LIBRARY_RING_H
+
+#include "kernel/ring.h"
+
+/*
+A ring batches object operations into a single syscall.  Queue
+operations with ring_read, ring_write, ring_open, and ring_close,
+each tagged with user_data, then call ring_submit to carry out
+everything queued so far, and collect results with ring_complete.
+Queueing fails with -1 when the ring is full, at which point the
+caller should submit and collect completions.
+*/
+
+int  ring_init(struct kernel_ring *r, int entries);
+void ring_free(struct kernel_ring *r);
+
+int  ring_read(struct kernel_ring *r, int fd, void *data, int length, kernel_io_flags_t flags, uint32_t user_data);
+int  ring_write(struct kernel_ring *r, int fd, const void *data, int length, kernel_io_flags_t flags, uint32_t user_data);
+int  ring_open(struct kernel_ring *r, int dirfd, const char *path, kernel_flags_t flags, uint32_t user_data);
+int  ring_close(struct kernel_ring *r, int fd, uint32_t user_data);
+
+int  ring_submit(struct kernel_ring *r);
+int  ring_complete(struct kernel_ring *r, struct kernel_ring_cqe *c);
+
+#endif
@@ -9,6 +9,7 @@ See the file LICENSE for details.
 
 #include "kernel/types.h"
 #include "kernel/stats.h"
+#include "kernel/ring.h"
 
 void syscall_debug(const char *str);
 
@@ -26,40 +27,66 @@ int syscall_process_kill(unsigned int pid);
 int syscall_process_reap(unsigned int pid);
 int syscall_process_wait(struct process_info *info, int timeout);
 int syscall_process_sleep(unsigned int ms);
+int syscall_process_nice(int pid, int nice);
 int syscall_process_stats(struct process_stats *s, unsigned int pid);
 extern void *syscall_process_heap(int a);
 
+/* Syscalls that create and collect threads sharing this address space. */
+
+int syscall_thread_create(void *entry, void *stack);
+void syscall_thread_exit(int status);
+int syscall_thread_join(int tid, int *status);
+
+/*
+Sleep while *addr == expected (for at most timeout ms, if not negative),
+or wake up to count sleepers on addr.  Works across shared memory.
+*/
+
+int syscall_futex_wait(volatile int *addr, int expected, int timeout);
+int syscall_futex_wake(volatile int *addr, int count);
+
 /* Syscalls that open or create new kernel objects for this process. */
 
 int syscall_open_file(int fd, const char *path, int mode, kernel_flags_t flags);
 int syscall_open_dir( int fd, const char *path, kernel_flags_t flags );
 int syscall_open_window(int fd, int x, int y, int w, int h);
 int syscall_open_console(int fd);
-int syscall_open_pipe();
+int syscall_open_pipe(int size);
+int syscall_open_shmem(int size);
+int syscall_open_systrace();
 
 /* Syscalls that manipulate kernel objects for this process. */
 
 int syscall_object_type(int fd);
 int syscall_object_copy( int src, int dst );
+int syscall_object_transfer(int src, int dst, int length);
 int syscall_object_read(int fd, void *data, int length, kernel_io_flags_t flags );
 int syscall_object_list( int fd, char *buffer, int buffer_len);
 int syscall_object_write(int fd, const void *data, int length, kernel_io_flags_t flags );
 int syscall_object_seek(int fd, int offset, int whence);
 int syscall_object_size(int fd, int * dims, int n);
+int syscall_object_resize(int fd, int size);
 int syscall_object_remove( int fd, const char *name );
 int syscall_object_close(int fd);
 int syscall_object_set_tag(int fd, char *tag);
 int syscall_object_get_tag(int fd, char *buffer, int buffer_size);
 int syscall_object_max();
+void *syscall_object_address(int fd);
+int syscall_object_poll(struct kernel_poll *fds, int n, int timeout);
+int syscall_ring_enter(struct kernel_ring *r);
 
 /* Syscalls that query or affect the whole system state. */
 
 int syscall_system_stats(struct system_stats *s);
 int syscall_bcache_stats(struct bcache_stats *s);
+int syscall_memory_stats(struct memory_stats *s);
+int syscall_memory_trace(int enable, struct memory_trace *t, int n);
+int syscall_syscall_stats(int enable, struct syscall_stats *s, int n);
 
 int syscall_bcache_flush();
 
 int syscall_system_time( uint32_t *t );
+int syscall_system_nanos( uint64_t *ns );
 int syscall_system_rtc( struct rtc_time *t );
 
 int syscall_device_driver_stats(char * name, struct device_driver_stats * stats);
@@ -0,0 +1,44 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#ifndef LIBRARY_THREAD_H
+#define LIBRARY_THREAD_H
+
+/*
+Threads share the memory and open objects of their process,
+each running on its own stack.  Returning from main, or calling
+exit from any thread, ends all of them.
+*/
+
+#define THREAD_STACK_SIZE (64*1024)
+
+struct thread;
+
+struct thread *thread_create(int (*func)(void *arg), void *arg);
+int  thread_join(struct thread *t, int *status);
+void thread_exit(int status);
+int  thread_id(struct thread *t);
+
+/*
+A mutex is taken and released without a syscall unless it is
+contended.  A waiter spins briefly, in case the holder is about
+to release it on another CPU, and then sleeps on a futex.
+The word is 0 when free, 1 when held, and 2 when held with
+possible sleepers, who must be woken on release.
+*/
+
+struct mutex {
+	volatile int locked;
+};
+
+#define MUTEX_INIT {0}
+
+void mutex_init(struct mutex *m);
+void mutex_lock(struct mutex *m);
+int  mutex_trylock(struct mutex *m);
+void mutex_unlock(struct mutex *m);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef LIBRARY_TIME_H
+#define LIBRARY_TIME_H
+
+#include "kernel/types.h"
+
+uint64_t time_nanos();
+
+#endif
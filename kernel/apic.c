@@ -0,0 +1,165 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+/*
+Each CPU has a local APIC, mapped at the same physical address,
+through which it receives its own timer and inter-processor
+interrupts, and sends interrupts to the other CPUs.
+*/
+
+#include "apic.h"
+#include "interrupt.h"
+#include "clock.h"
+#include "console.h"
+
+#define APIC_ID            0x020
+#define APIC_TPR           0x080
+#define APIC_EOI           0x0b0
+#define APIC_SPURIOUS      0x0f0
+#define APIC_ICR_LOW       0x300
+#define APIC_ICR_HIGH      0x310
+#define APIC_LVT_TIMER     0x320
+#define APIC_LVT_LINT0     0x350
+#define APIC_LVT_LINT1     0x360
+#define APIC_TIMER_INITIAL 0x380
+#define APIC_TIMER_CURRENT 0x390
+#define APIC_TIMER_DIVIDE  0x3e0
+
+#define APIC_ENABLE        0x100
+#define APIC_MASKED        0x10000
+#define APIC_PERIODIC      0x20000
+#define APIC_DIVIDE_16     0x3
+
+#define APIC_ICR_INIT      0x500
+#define APIC_ICR_STARTUP   0x600
+#define APIC_ICR_PENDING   0x1000
+#define APIC_ICR_ASSERT    0x4000
+#define APIC_ICR_LEVEL     0x8000
+
+/* The timer is calibrated over this many milliseconds. */
+#define APIC_CALIBRATE_MILLIS 10
+
+static volatile uint32_t *apic_base = 0;
+static uint32_t apic_timer_count = 0;
+
+static uint32_t apic_read(int reg)
+{
+	return apic_base[reg / 4];
+}
+
+static void apic_write(int reg, uint32_t value)
+{
+	apic_base[reg / 4] = value;
+	apic_read(APIC_ID);
+}
+
+/*
+Enable the local APIC of the calling CPU.  The boot CPU keeps
+its LINT pins as the BIOS left them, so that the legacy PIC
+still reaches it in virtual wire mode.
+*/
+
+void apic_init(uint32_t base, int bsp)
+{
+	apic_base = (volatile uint32_t *) base;
+
+	apic_write(APIC_SPURIOUS, APIC_ENABLE | INTERRUPT_APIC_SPURIOUS);
+	apic_write(APIC_TPR, 0);
+	apic_write(APIC_LVT_TIMER, APIC_MASKED);
+
+	if(!bsp) {
+		apic_write(APIC_LVT_LINT0, APIC_MASKED);
+		apic_write(APIC_LVT_LINT1, APIC_MASKED);
+	}
+
+	apic_eoi();
+}
+
+uint32_t apic_address()
+{
+	return (uint32_t) apic_base;
+}
+
+int apic_id()
+{
+	if(!apic_base)
+		return 0;
+	return apic_read(APIC_ID) >> 24;
+}
+
+void apic_eoi()
+{
+	if(apic_base)
+		apic_write(APIC_EOI, 0);
+}
+
+static void apic_send(int apic_id, uint32_t command)
+{
+	while(apic_read(APIC_ICR_LOW) & APIC_ICR_PENDING) {
+		/* wait for the previous command */
+	}
+	apic_write(APIC_ICR_HIGH, apic_id << 24);
+	apic_write(APIC_ICR_LOW, command);
+	while(apic_read(APIC_ICR_LOW) & APIC_ICR_PENDING) {
+		/* wait for delivery */
+	}
+}
+
+void apic_send_init(int apic_id)
+{
+	apic_send(apic_id, APIC_ICR_INIT | APIC_ICR_LEVEL | APIC_ICR_ASSERT);
+	apic_send(apic_id, APIC_ICR_INIT | APIC_ICR_LEVEL);
+}
+
+void apic_send_startup(int apic_id, uint32_t address)
+{
+	apic_send(apic_id, APIC_ICR_STARTUP | (address >> 12));
+}
+
+void apic_send_ipi(int apic_id, int vector)
+{
+	apic_send(apic_id, vector);
+}
+
+/*
+Count APIC timer ticks across a known interval measured by the
+system clock, to find the count for one click of the scheduler.
+*/
+
+void apic_timer_calibrate()
+{
+	uint64_t stop;
+	uint32_t elapsed;
+
+	apic_write(APIC_TIMER_DIVIDE, APIC_DIVIDE_16);
+	apic_write(APIC_LVT_TIMER, APIC_MASKED);
+	apic_write(APIC_TIMER_INITIAL, 0xffffffff);
+
+	stop = clock_nanos() + APIC_CALIBRATE_MILLIS * 1000000;
+	while(clock_nanos() < stop) {
+		/* wait */
+	}
+
+	elapsed = 0xffffffff - apic_read(APIC_TIMER_CURRENT);
+	apic_write(APIC_TIMER_INITIAL, 0);
+
+	apic_timer_count = elapsed / APIC_CALIBRATE_MILLIS * 1000 / CLICKS_PER_SECOND;
+
+	printf("apic: timer at %d ticks per click\n", apic_timer_count);
+}
+
+void apic_timer_start()
+{
+	apic_write(APIC_TIMER_DIVIDE, APIC_DIVIDE_16);
+	apic_write(APIC_LVT_TIMER, APIC_PERIODIC | INTERRUPT_APIC_TIMER);
+	apic_write(APIC_TIMER_INITIAL, apic_timer_count);
+}
+
+void apic_timer_stop()
+{
+	apic_write(APIC_LVT_TIMER, APIC_MASKED);
+	apic_write(APIC_TIMER_INITIAL, 0);
+}
@@ -0,0 +1,23 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#ifndef APIC_H
+#define APIC_H
+
+#include "kernel/types.h"
+
+void apic_init(uint32_t base, int bsp);
+uint32_t apic_address();
+int  apic_id();
+void apic_eoi();
+void apic_send_init(int apic_id);
+void apic_send_startup(int apic_id, uint32_t address);
+void apic_send_ipi(int apic_id, int vector);
+void apic_timer_calibrate();
+void apic_timer_start();
+void apic_timer_stop();
+
+#endif
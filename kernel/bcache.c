@@ -10,6 +10,7 @@ See the file LICENSE for details.
 #include "kmalloc.h"
 #include "string.h"
 #include "kernel/error.h"
+#include "spinlock.h"
 
 struct bcache_entry {
 	struct list_node node;
@@ -23,14 +24,21 @@ static struct list cache = LIST_INIT;
 static struct bcache_stats stats = {0};
 static int max_cache_size = 100;
 
+/*
+The lock covers the cache list and statistics, but is let go
+around device I/O, which may sleep.
+*/
+
+static struct spinlock bcache_lock = SPINLOCK_INIT;
+
 struct bcache_entry * bcache_entry_create( struct device *device, int block )
 {
-	struct bcache_entry *e = kmalloc(sizeof(*e));
+	struct bcache_entry *e = kmalloc_tag(sizeof(*e), MEMORY_TAG_BCACHE);
 	if(!e) return 0;
 
 	e->device = device;
 	e->block = block;
-	e->data = page_alloc(1);
+	e->data = page_alloc_tag(1, MEMORY_TAG_BCACHE);
 	if(!e->data) {
 		kfree(e);
 		return 0;
@@ -48,13 +56,17 @@ void bcache_entry_delete( struct bcache_entry *e )
 	}
 }
 
+/* Called with bcache_lock held. */
+
 void bcache_entry_clean( struct bcache_entry *e )
 {
 	if(e->dirty) {
-		device_write(e->device,e->data,1,e->block);
-		// XXX How to deal with failure here?
 		e->dirty = 0;
 		stats.writebacks++;
+		spinlock_release(&bcache_lock);
+		device_write(e->device,e->data,1,e->block);
+		// XXX How to deal with failure here?
+		spinlock_acquire(&bcache_lock);
 	}
 
 }
@@ -107,15 +119,22 @@ int bcache_read_block( struct device *device, char *data, int block )
 	int hit=0;
 	int result;
 
+	spinlock_acquire(&bcache_lock);
+
 	struct bcache_entry *e = bcache_find_or_create(device,block,&hit);
-	if(!e) return KERROR_OUT_OF_MEMORY;
+	if(!e) {
+		spinlock_release(&bcache_lock);
+		return KERROR_OUT_OF_MEMORY;
+	}
 
 	if(hit) {
 		stats.read_hits++;
 		result = 1;
 	} else {
 		stats.read_misses++;
+		spinlock_release(&bcache_lock);
 		result = device_read(device,e->data,1,block);
+		spinlock_acquire(&bcache_lock);
 	}
 
 	if(result>0) {
@@ -125,6 +144,8 @@ int bcache_read_block( struct device *device, char *data, int block )
 		bcache_entry_delete(e);
 	}
 
+	spinlock_release(&bcache_lock);
+
 	return result;
 }
 
@@ -152,8 +173,13 @@ int bcache_write_block( struct device *device, const char *data, int block )
 {
 	int hit;
 
+	spinlock_acquire(&bcache_lock);
+
 	struct bcache_entry *e = bcache_find_or_create(device,block,&hit);
-	if(!e) return KERROR_OUT_OF_MEMORY;
+	if(!e) {
+		spinlock_release(&bcache_lock);
+		return KERROR_OUT_OF_MEMORY;
+	}
 
 	if(hit) {
 		stats.write_hits++;
@@ -164,6 +190,8 @@ int bcache_write_block( struct device *device, const char *data, int block )
 	memcpy(e->data,data,device_block_size(device));
 	e->dirty = 1;
 
+	spinlock_release(&bcache_lock);
+
 	return 1;
 }
 
@@ -190,8 +218,10 @@ int bcache_write( struct device *device, const char *data, int blocks, int offse
 void bcache_flush_block( struct device *device, int block )
 {
 	struct bcache_entry *e;
+	spinlock_acquire(&bcache_lock);
 	e = bcache_find(device,block);
 	if(e) bcache_entry_clean(e);
+	spinlock_release(&bcache_lock);
 }
 
 void bcache_flush_device( struct device *device )
@@ -199,12 +229,14 @@ void bcache_flush_device( struct device *device )
 	struct list_node *n;
 	struct bcache_entry *e;
 
+	spinlock_acquire(&bcache_lock);
 	for(n=cache.head;n;n=n->next) {
 		e = (struct bcache_entry *) n;
 		if(e->device==device) {
 			bcache_entry_clean(e);
 		}
 	}
+	spinlock_release(&bcache_lock);
 }
 
 void bcache_flush_all()
@@ -212,13 +244,17 @@ void bcache_flush_all()
 	struct list_node *n;
 	struct bcache_entry *e;
 
+	spinlock_acquire(&bcache_lock);
 	for(n=cache.head;n;n=n->next) {
 		e = (struct bcache_entry *) n;
 		bcache_entry_clean(e);
 	}
+	spinlock_release(&bcache_lock);
 }
 
 void bcache_get_stats( struct bcache_stats *s )
 {
+	spinlock_acquire(&bcache_lock);
 	memcpy(s,&stats,sizeof(*s));
+	spinlock_release(&bcache_lock);
 }
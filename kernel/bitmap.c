@@ -21,11 +21,11 @@ struct bitmap *bitmap_create_root()
 
 struct bitmap *bitmap_create(int width, int height, int format)
 {
-	struct bitmap *b = kmalloc(sizeof(*b));
+	struct bitmap *b = kmalloc_tag(sizeof(*b), MEMORY_TAG_GRAPHICS);
 	if(!b)
 		return 0;
 
-	b->data = kmalloc(width * height * 3);
+	b->data = kmalloc_tag(width * height * 3, MEMORY_TAG_GRAPHICS);
 	if(!b->data) {
 		kfree(b);
 		return 0;
@@ -18,13 +18,14 @@ See the file LICENSE for details.
 
 static struct fs_dirent *cdrom_dirent_create(struct fs_volume *volume, int sector, int length, int isdir)
 {
-	struct fs_dirent *d = kmalloc(sizeof(*d));
+	struct fs_dirent *d = kmalloc_tag(sizeof(*d), MEMORY_TAG_FS);
 	if(!d) return 0;
 
 	d->volume = volume;
 	d->refcount = 1;
 	d->size = length;
 	d->isdir = isdir;
+	d->inumber = sector;
 	d->cdrom.sector = sector;
 
 	return d;
@@ -61,7 +62,7 @@ static struct fs_dirent *cdrom_dirent_lookup(struct fs_dirent *dir, const char *
 {
 	if(!dir->isdir) return 0;
 
-	char *temp = page_alloc(0);
+	char *temp = page_alloc_tag(0, MEMORY_TAG_FS);
 	if(!temp) return 0;
 
 	int nsectors = dir->size / CDROMFS_BLOCK_SIZE + (dir->size % CDROMFS_BLOCK_SIZE ? 1 : 0);
@@ -118,7 +119,7 @@ static int cdrom_dirent_list(struct fs_dirent *dir, char *buffer, int buffer_len
 {
 	if(!dir->isdir) return KERROR_NOT_A_DIRECTORY;
 
-	char *temp = page_alloc(0);
+	char *temp = page_alloc_tag(0, MEMORY_TAG_FS);
 	if(!temp) return KERROR_OUT_OF_MEMORY;
 
 	int nsectors = dir->size / CDROMFS_BLOCK_SIZE + (dir->size % CDROMFS_BLOCK_SIZE ? 1 : 0);
@@ -169,7 +170,7 @@ static int cdrom_dirent_list(struct fs_dirent *dir, char *buffer, int buffer_len
 
 static struct fs_volume *cdrom_volume_create( struct device *device )
 {
-	struct fs_volume *v = kmalloc(sizeof(*v));
+	struct fs_volume *v = kmalloc_tag(sizeof(*v), MEMORY_TAG_FS);
 	if(!v) return 0;
 
 	memset(v, 0, sizeof(struct fs_volume));
@@ -189,7 +190,7 @@ static struct fs_volume *cdrom_volume_open( struct device *device )
 {
 	struct fs_volume *v = cdrom_volume_create(device);
 
-	struct iso_9660_volume_descriptor *d = page_alloc(0);
+	struct iso_9660_volume_descriptor *d = page_alloc_tag(0, MEMORY_TAG_FS);
 	if(!d) {
 		kfree(v);
 		return 0;
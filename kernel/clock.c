@@ -8,40 +8,121 @@ See the file LICENSE for details.
 #include "clock.h"
 #include "ioports.h"
 #include "process.h"
-
-// Minimum PIT frequency is 18.2Hz.
-#define CLICKS_PER_SECOND 20
+#include "page.h"
+#include "cpu.h"
+#include "kernel/timepage.h"
 
 #define TIMER0		0x40
+#define TIMER2		0x42
 #define TIMER_MODE	0x43
+#define TIMER_GATE	0x61
 #define SQUARE_WAVE     0x36
+#define ONE_SHOT_0	0x30
+#define ONE_SHOT_2	0xb0
+#define READ_BACK_0	0xc2
+#define STATUS_OUTPUT	0x80
 #define TIMER_FREQ	1193182
 #define TIMER_COUNT	(((unsigned)TIMER_FREQ)/CLICKS_PER_SECOND)
 
-static uint32_t clicks = 0;
-static uint32_t seconds = 0;
+/*
+The timestamp counter is calibrated by counting cycles while
+PIT channel 2 counts down this many ticks, about 10ms.
+*/
+
+#define CALIBRATE_COUNT 11932
+
+/*
+The longest one-shot countdown that fits in the 16-bit PIT counter.
+*/
 
-static struct list queue = { 0, 0 };
+#define ONE_SHOT_MAX_CLICKS (0xffff / TIMER_COUNT)
+
+static uint32_t total_clicks = 0;
+
+/* Nonzero while the PIT is counting down a one-shot idle period. */
+static uint32_t oneshot_clicks = 0;
+
+static struct time_page *time_page = 0;
+
+static struct clock_timer *timers = 0;
+
+#define CLOCK_EXPIRED(t) ((int32_t) (total_clicks - (t)->deadline) >= 0)
+
+static void clock_periodic()
+{
+	outb(SQUARE_WAVE, TIMER_MODE);
+	outb((TIMER_COUNT & 0xff), TIMER0);
+	outb((TIMER_COUNT >> 8) & 0xff, TIMER0);
+}
 
 static void clock_interrupt(int i, int code)
 {
-	clicks++;
-	process_wakeup_all(&queue);
-	if(clicks >= CLICKS_PER_SECOND) {
-		clicks = 0;
-		seconds++;
-		process_preempt();
+	if(oneshot_clicks) {
+		total_clicks += oneshot_clicks;
+		oneshot_clicks = 0;
+		clock_periodic();
+	} else {
+		total_clicks++;
+	}
+
+	while(timers && CLOCK_EXPIRED(timers)) {
+		struct clock_timer *t = timers;
+		timers = t->next;
+		t->active = 0;
+		t->expired = 1;
+		process_unblock(t->process);
+	}
+
+	process_tick();
+}
+
+/*
+Divide a 64-bit value by a 32-bit one, as a pair of divl
+instructions, since there is no libgcc to do it for us.
+*/
+
+uint64_t clock_divide(uint64_t n, uint32_t d, uint32_t *rem)
+{
+	uint32_t hi = n >> 32;
+	uint32_t qhi = hi / d;
+	uint32_t qlo, r;
+
+	asm("divl %4":"=a"(qlo), "=d"(r):"a"((uint32_t) n), "d"(hi % d), "rm"(d));
+
+	if(rem)
+		*rem = r;
+
+	return ((uint64_t) qhi << 32) | qlo;
+}
+
+/*
+Nanoseconds since boot, from the timestamp counter if it could be
+calibrated, or else from the count of clock interrupts.
+*/
+
+uint64_t clock_nanos()
+{
+	if(time_page && time_page->tsc_valid) {
+		return time_page_nanos(time_page);
+	} else {
+		return (uint64_t) total_clicks * (1000000000 / CLICKS_PER_SECOND);
 	}
 }
 
 clock_t clock_read()
 {
 	clock_t result;
-	result.seconds = seconds;
-	result.millis = 1000 * clicks / CLICKS_PER_SECOND;
+	uint32_t rem;
+	result.seconds = clock_divide(clock_nanos(), 1000000000, &rem);
+	result.millis = rem / 1000000;
 	return result;
 }
 
+void *clock_time_page()
+{
+	return time_page;
+}
+
 clock_t clock_diff(clock_t start, clock_t stop)
 {
 	clock_t result;
@@ -54,24 +135,171 @@ clock_t clock_diff(clock_t start, clock_t stop)
 	return result;
 }
 
+/*
+Arrange for process p to be unblocked once millis have passed,
+inserting the timer in deadline order.  The caller should have
+interrupts blocked until p is actually waiting.  Only the boot
+CPU fires timers, so if it is idle on a countdown to a later
+deadline, wake it to count down to this one instead.
+*/
+
+void clock_timer_start(struct clock_timer *t, struct process *p, uint32_t millis)
+{
+	struct clock_timer **prev = &timers;
+
+	t->process = p;
+	t->deadline = total_clicks + 1 + (millis * CLICKS_PER_SECOND + 999) / 1000;
+	t->expired = 0;
+	t->active = 1;
+
+	while(*prev && (int32_t) ((*prev)->deadline - t->deadline) <= 0) {
+		prev = &(*prev)->next;
+	}
+
+	t->next = *prev;
+	*prev = t;
+
+	if(timers == t && cpus[0].idle)
+		cpu_wake(&cpus[0]);
+}
+
+void clock_timer_cancel(struct clock_timer *t)
+{
+	struct clock_timer **prev = &timers;
+	int enabled = interrupt_block_save();
+
+	if(t->active) {
+		while(*prev) {
+			if(*prev == t) {
+				*prev = t->next;
+				break;
+			}
+			prev = &(*prev)->next;
+		}
+		t->active = 0;
+	}
+	interrupt_restore(enabled);
+}
+
+/*
+Before halting an idle CPU, replace the periodic tick with a single
+interrupt at the nearest timer deadline, or as far out as the PIT
+can count if nothing is waiting.  Called with interrupts blocked.
+*/
+
+void clock_idle_begin()
+{
+	uint32_t clicks = ONE_SHOT_MAX_CLICKS;
+	uint32_t count;
+
+	if(timers) {
+		int32_t delta = timers->deadline - total_clicks;
+		if(delta < (int32_t) clicks)
+			clicks = delta;
+	}
+
+	if(clicks < 2)
+		return;
+
+	count = clicks * TIMER_COUNT;
+	outb(ONE_SHOT_0, TIMER_MODE);
+	outb(count & 0xff, TIMER0);
+	outb((count >> 8) & 0xff, TIMER0);
+	oneshot_clicks = clicks;
+}
+
+/*
+After something other than the clock ends an idle period, credit
+the clicks that passed during the countdown and resume ticking.
+Called with interrupts blocked.
+*/
+
+void clock_idle_end()
+{
+	uint8_t status;
+	uint32_t remaining;
+
+	if(!oneshot_clicks)
+		return;
+
+	outb(READ_BACK_0, TIMER_MODE);
+	status = inb(TIMER0);
+	remaining = inb(TIMER0);
+	remaining |= inb(TIMER0) << 8;
+
+	if(status & STATUS_OUTPUT) {
+		total_clicks += oneshot_clicks;
+	} else {
+		total_clicks += (oneshot_clicks * TIMER_COUNT - remaining) / TIMER_COUNT;
+	}
+
+	oneshot_clicks = 0;
+	clock_periodic();
+}
+
 void clock_wait(uint32_t millis)
 {
-	clock_t start, elapsed;
-	uint32_t total;
-
-	start = clock_read();
-	do {
-		process_wait(&queue);
-		elapsed = clock_diff(start, clock_read());
-		total = elapsed.millis + elapsed.seconds * 1000;
-	} while(total < millis);
+	struct list queue = { 0, 0, 0 };
+	uint64_t deadline = clock_nanos() + (uint64_t) millis * 1000000;
+	uint64_t now;
+
+	/* Nothing else wakes this queue, so only the timer ends each wait. */
+	while((now = clock_nanos()) < deadline) {
+		process_wait_timeout(&queue, clock_divide(deadline - now + 999999, 1000000, 0));
+	}
+}
+
+/*
+Count timestamp cycles during a one-shot countdown of PIT channel 2,
+and from that work out the multiplier that turns cycles into nanoseconds.
+*/
+
+static void clock_calibrate()
+{
+	uint32_t eax, ebx, ecx, edx;
+	uint64_t start, cycles, nanos;
+
+	asm volatile ("cpuid":"=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx):"a"(1));
+	if(!(edx & (1 << 4))) {
+		printf("clock: no timestamp counter\n");
+		return;
+	}
+
+	uint8_t gate = inb(TIMER_GATE);
+	outb((gate & ~0x02) | 0x01, TIMER_GATE);
+	outb(ONE_SHOT_2, TIMER_MODE);
+	outb(CALIBRATE_COUNT & 0xff, TIMER2);
+	outb((CALIBRATE_COUNT >> 8) & 0xff, TIMER2);
+
+	start = time_page_rdtsc();
+	while(!(inb(TIMER_GATE) & 0x20)) {
+		/* wait for the countdown */
+	}
+	cycles = time_page_rdtsc() - start;
+
+	outb(gate, TIMER_GATE);
+
+	nanos = clock_divide((uint64_t) CALIBRATE_COUNT * 1000000000, TIMER_FREQ, 0);
+
+	/* The multiplier must fit in 32 bits. */
+	if((cycles >> 32) || (nanos << TIME_PAGE_SHIFT) >> 32 >= cycles) {
+		printf("clock: couldn't calibrate timestamp counter\n");
+		return;
+	}
+
+	time_page->tsc_mult = clock_divide(nanos << TIME_PAGE_SHIFT, cycles, 0);
+	time_page->tsc_base = time_page_rdtsc();
+	time_page->tsc_valid = 1;
+
+	printf("clock: timestamp counter at %d MHz\n", (uint32_t) cycles / ((uint32_t) nanos / 1000));
 }
 
 void clock_init()
 {
-	outb(SQUARE_WAVE, TIMER_MODE);
-	outb((TIMER_COUNT & 0xff), TIMER0);
-	outb((TIMER_COUNT >> 8) & 0xff, TIMER0);
+	time_page = page_alloc(1);
+	clock_calibrate();
+
+	clock_periodic();
 
 	interrupt_register(32, clock_interrupt);
 	interrupt_enable(32);
@@ -9,14 +9,48 @@ See the file LICENSE for details.
 
 #include "kernel/types.h"
 
+/*
+The PIT interrupts this many times per second, which sets
+the resolution of clock_read and of the scheduler quantum.
+Minimum PIT frequency is 18.2Hz.
+*/
+
+#ifndef CLICKS_PER_SECOND
+#define CLICKS_PER_SECOND 1000
+#endif
+
 typedef struct {
 	uint32_t seconds;
 	uint32_t millis;
 } clock_t;
 
+struct process;
+
+/*
+A pending wakeup for a blocked process.  Timers are kept
+in order of deadline, so the clock interrupt only looks
+at the ones that have actually expired.
+*/
+
+struct clock_timer {
+	struct clock_timer *next;
+	struct process *process;
+	uint32_t deadline;
+	int active;
+	int expired;
+};
+
 void clock_init();
 clock_t clock_read();
+uint64_t clock_nanos();
+uint64_t clock_divide(uint64_t n, uint32_t d, uint32_t *rem);
+void *clock_time_page();
 clock_t clock_diff(clock_t start, clock_t stop);
 void clock_wait(uint32_t millis);
+void clock_idle_begin();
+void clock_idle_end();
+
+void clock_timer_start(struct clock_timer *t, struct process *p, uint32_t millis);
+void clock_timer_cancel(struct clock_timer *t);
 
 #endif
@@ -176,6 +176,16 @@ int console_read_nonblock( struct console *c, char *data, int length )
 	return total;
 }
 
+/*
+Return true if a keypress is waiting to be read.  If w is given,
+it is hung on the window to be woken by the next event.
+*/
+
+int console_poll( struct console *c, struct poll_waiter *w )
+{
+	return window_poll(c->window,EVENT_KEY_DOWN,w);
+}
+
 int console_getchar( struct console *c )
 {
 	char ch;
@@ -198,7 +208,7 @@ void console_putstring( struct console *c, const char *str)
 
 struct console *console_create( struct window *w )
 {
-	struct console *c = kmalloc(sizeof(*c));
+	struct console *c = kmalloc_tag(sizeof(*c), MEMORY_TAG_GRAPHICS);
 	c->window = window_addref(w);
 	c->gx = window_graphics(w);
 	c->refcount = 1;
@@ -37,6 +37,7 @@ int  console_post( struct console *c, const char *data, int length );
 int  console_write( struct console *c, const char *data, int length );
 int  console_read( struct console *c, char *data, int length );
 int  console_read_nonblock( struct console *c, char *data, int length );
+int  console_poll( struct console *c, struct poll_waiter *w );
 int  console_getchar( struct console *c );
 void console_putchar( struct console *c, char ch );
 void console_putstring( struct console *c, const char *str );
@@ -0,0 +1,385 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+/*
+Discover the processors from the Intel MultiProcessor table
+left by the BIOS, and start each secondary CPU through the
+trampoline in kernelcore.S.  Device interrupts still arrive
+through the PIC at the boot CPU, while each secondary CPU
+takes scheduler ticks from its own local APIC timer.
+*/
+
+#include "cpu.h"
+#include "apic.h"
+#include "interrupt.h"
+#include "process.h"
+#include "pagetable.h"
+#include "page.h"
+#include "string.h"
+#include "clock.h"
+#include "console.h"
+#include "spinlock.h"
+#include "kernelcore.h"
+
+#define MP_PROCESSOR 0
+#define MP_BUS       1
+#define MP_IOAPIC    2
+
+#define MP_PROCESSOR_ENABLED 0x01
+#define MP_PROCESSOR_BOOT    0x02
+
+/* How long to wait for a secondary CPU to report in. */
+#define CPU_START_MILLIS 100
+
+struct mp_floating {
+	char signature[4];
+	uint32_t config;
+	uint8_t length;
+	uint8_t revision;
+	uint8_t checksum;
+	uint8_t features[5];
+};
+
+struct mp_config {
+	char signature[4];
+	uint16_t length;
+	uint8_t revision;
+	uint8_t checksum;
+	char oem[8];
+	char product[12];
+	uint32_t oem_table;
+	uint16_t oem_length;
+	uint16_t entry_count;
+	uint32_t apic_address;
+	uint16_t extended_length;
+	uint8_t extended_checksum;
+	uint8_t reserved;
+};
+
+struct mp_processor {
+	uint8_t type;
+	uint8_t apic_id;
+	uint8_t apic_version;
+	uint8_t flags;
+	uint32_t signature;
+	uint32_t features;
+	uint32_t reserved[2];
+};
+
+struct mp_ioapic {
+	uint8_t type;
+	uint8_t id;
+	uint8_t version;
+	uint8_t flags;
+	uint32_t address;
+};
+
+struct cpu cpus[CPU_MAX];
+int cpu_count = 1;
+struct pagetable *cpu_idle_pagetable = 0;
+
+/* Read by cpu_trampoline32 to find the stack of the CPU being started. */
+char *cpu_boot_stack = 0;
+static int cpu_boot_index = 0;
+
+static int cpu_found = 1;
+static uint32_t cpu_ioapic_address = 0;
+
+static uint8_t cpu_checksum(void *addr, int length)
+{
+	uint8_t *p = addr;
+	uint8_t sum = 0;
+	while(length-- > 0)
+		sum += *p++;
+	return sum;
+}
+
+static struct mp_floating *cpu_mp_search(uint32_t start, uint32_t length)
+{
+	uint32_t addr;
+	for(addr = start; addr < start + length; addr += 16) {
+		struct mp_floating *f = (struct mp_floating *) addr;
+		if(!strncmp(f->signature, "_MP_", 4) && !cpu_checksum(f, 16))
+			return f;
+	}
+	return 0;
+}
+
+/*
+The floating pointer lives in the first KB of the extended BIOS
+data area, in the last KB of base memory, or in the BIOS ROM.
+*/
+
+static struct mp_config *cpu_mp_find()
+{
+	struct mp_floating *f;
+	struct mp_config *c;
+	uint32_t ebda = (*(uint16_t *) 0x40e) << 4;
+	uint32_t basemem = (*(uint16_t *) 0x413) * 1024;
+
+	f = 0;
+	if(ebda)
+		f = cpu_mp_search(ebda, 1024);
+	if(!f)
+		f = cpu_mp_search(basemem - 1024, 1024);
+	if(!f)
+		f = cpu_mp_search(0xf0000, 0x10000);
+	if(!f || !f->config)
+		return 0;
+
+	c = (struct mp_config *) f->config;
+	if(strncmp(c->signature, "PCMP", 4) || cpu_checksum(c, c->length))
+		return 0;
+
+	return c;
+}
+
+static void cpu_mp_parse(struct mp_config *c)
+{
+	uint8_t *entry = (uint8_t *) (c + 1);
+	int i;
+
+	for(i = 0; i < c->entry_count; i++) {
+		if(*entry == MP_PROCESSOR) {
+			struct mp_processor *p = (struct mp_processor *) entry;
+			if(p->flags & MP_PROCESSOR_BOOT) {
+				cpus[0].apic_id = p->apic_id;
+			} else if(p->flags & MP_PROCESSOR_ENABLED && cpu_found < CPU_MAX) {
+				cpus[cpu_found].id = cpu_found;
+				cpus[cpu_found].apic_id = p->apic_id;
+				cpu_found++;
+			}
+			entry += sizeof(struct mp_processor);
+		} else if(*entry == MP_IOAPIC) {
+			struct mp_ioapic *a = (struct mp_ioapic *) entry;
+			if(!cpu_ioapic_address)
+				cpu_ioapic_address = a->address;
+			entry += sizeof(struct mp_ioapic);
+		} else {
+			/* Bus and interrupt assignment entries are all eight bytes. */
+			entry += 8;
+		}
+	}
+}
+
+/*
+Point this CPU's slot in the GDT at its own TSS and load it.
+The slot must be marked available, not busy, for ltr to work.
+*/
+
+static void cpu_tss_load(struct cpu *c)
+{
+	struct x86_segment *s = &gdt[(X86_SEGMENT_TSS >> 3) + c->id];
+	uint32_t base = (uint32_t) &c->tss;
+	uint16_t selector = X86_SEGMENT_TSS + c->id * 8;
+
+	c->tss.ss0 = X86_SEGMENT_KERNEL_DATA;
+	c->tss.esp0 = (int32_t) c->stack_top;
+	c->tss.iomap = sizeof(c->tss);
+
+	memset(s, 0, sizeof(*s));
+	s->limit0 = sizeof(c->tss) - 1;
+	s->base0 = base & 0xffff;
+	s->base1 = (base >> 16) & 0xff;
+	s->base2 = (base >> 24) & 0xff;
+	s->type = 9;
+	s->present = 1;
+
+	asm volatile ("ltr %0"::"r"(selector));
+}
+
+/*
+Point the SYSENTER MSRs at the fast system call entry.  The
+stack MSR points into a small per-CPU entry stack, because
+esp0 changes with every process switch: the top word holds
+the address of this CPU's esp0, and the entry stub loads the
+real kernel stack through it once the user flags are gone.  CPUs
+without SEP leave the MSRs alone, and user code falls back
+to the int $48 gate after finding the same bit clear.
+*/
+
+int cpu_sysenter_enabled = 0;
+
+static void cpu_wrmsr(uint32_t msr, uint32_t value)
+{
+	asm volatile ("wrmsr"::"c"(msr), "a"(value), "d"(0));
+}
+
+static void cpu_sysenter_init(struct cpu *c)
+{
+	uint32_t eax, ebx, ecx, edx;
+
+	asm volatile ("cpuid":"=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx):"a"(1));
+	if(!(edx & (1 << 11))) return;
+
+	cpu_wrmsr(X86_MSR_SYSENTER_CS, X86_SEGMENT_KERNEL_CODE);
+	c->sysenter_stack[15] = (uint32_t) &c->tss.esp0;
+	cpu_wrmsr(X86_MSR_SYSENTER_ESP, (uint32_t) &c->sysenter_stack[15]);
+	cpu_wrmsr(X86_MSR_SYSENTER_EIP, (uint32_t) sysenter_entry);
+
+	cpu_sysenter_enabled = 1;
+}
+
+static void cpu_timer_interrupt(int i, int code)
+{
+	process_tick();
+}
+
+static void cpu_wake_interrupt(int i, int code)
+{
+	/* Nothing to do: the scheduler looks again on the way out. */
+}
+
+static void cpu_spurious_interrupt(int i, int code)
+{
+}
+
+void cpu_init()
+{
+	struct mp_config *c;
+
+	cpus[0].id = 0;
+	cpus[0].started = 1;
+	cpus[0].stack_top = (char *) page_alloc(1) + PAGE_SIZE;
+	cpu_tss_load(&cpus[0]);
+	cpu_sysenter_init(&cpus[0]);
+
+	cpu_idle_pagetable = pagetable_create();
+
+	interrupt_register(INTERRUPT_APIC_TIMER, cpu_timer_interrupt);
+	interrupt_register(INTERRUPT_APIC_WAKE, cpu_wake_interrupt);
+	interrupt_register(INTERRUPT_APIC_SPURIOUS, cpu_spurious_interrupt);
+
+	c = cpu_mp_find();
+	if(!c) {
+		pagetable_init(cpu_idle_pagetable);
+		printf("cpu: no multiprocessor table, using one cpu\n");
+		return;
+	}
+
+	cpu_mp_parse(c);
+	apic_init(c->apic_address, 1);
+	apic_timer_calibrate();
+
+	/* The APIC must be mapped before any page table is built. */
+	pagetable_init(cpu_idle_pagetable);
+
+	printf("cpu: %d found, apic at %x, ioapic at %x%s\n", cpu_found, c->apic_address, cpu_ioapic_address, cpu_sysenter_enabled ? ", sysenter" : "");
+}
+
+static void cpu_delay(uint32_t micros)
+{
+	uint64_t stop = clock_nanos() + micros * 1000;
+	while(clock_nanos() < stop) {
+		/* wait */
+	}
+}
+
+/*
+Secondary CPUs begin here on their own stacks, in protected
+mode but without paging.  Each waits for the kernel lock and
+then enters the scheduler, never to return.
+*/
+
+void cpu_ap_main()
+{
+	struct cpu *c = &cpus[cpu_boot_index];
+
+	cpu_tss_load(c);
+	cpu_sysenter_init(c);
+	pagetable_load(cpu_idle_pagetable);
+	pagetable_enable();
+	apic_init(apic_address(), 0);
+	apic_timer_start();
+
+	c->started = 1;
+
+	kernel_lock_acquire();
+	printf("cpu: %d started\n", c->id);
+	process_cpu_start();
+}
+
+/*
+Send each secondary CPU the INIT, STARTUP, STARTUP sequence,
+one at a time, so that they may share the trampoline.
+*/
+
+void cpu_start_all()
+{
+	int i, waited;
+	uint32_t length = (uint32_t) cpu_trampoline_end - (uint32_t) cpu_trampoline;
+
+	memcpy((void *) CPU_TRAMPOLINE, cpu_trampoline, length);
+
+	for(i = 1; i < cpu_found; i++) {
+		struct cpu *c = &cpus[i];
+
+		c->stack_top = (char *) page_alloc(1) + PAGE_SIZE;
+		cpu_boot_stack = c->stack_top;
+		cpu_boot_index = i;
+
+		apic_send_init(c->apic_id);
+		cpu_delay(10000);
+		apic_send_startup(c->apic_id, CPU_TRAMPOLINE);
+		cpu_delay(200);
+		apic_send_startup(c->apic_id, CPU_TRAMPOLINE);
+
+		for(waited = 0; !c->started && waited < CPU_START_MILLIS; waited++) {
+			cpu_delay(1000);
+		}
+
+		if(!c->started) {
+			printf("cpu: %d (apic %d) did not start\n", i, c->apic_id);
+			break;
+		}
+
+		cpu_count++;
+	}
+}
+
+/*
+Interrupt a CPU that may be halted in the idle loop,
+so that it looks at the run queues again.
+*/
+
+void cpu_wake(struct cpu *c)
+{
+	if(c != cpu_self() && c->started)
+		apic_send_ipi(c->apic_id, INTERRUPT_APIC_WAKE);
+}
+
+/*
+After a mapping is removed from pt, other CPUs running threads in
+pt may still hold the old translation.  Ask each of them to reload
+its page table, and wait until they all have, so that the pages
+may be reused.  The request is answered while the CPU spins for
+the kernel lock, which the caller holds, on its way into the kernel.
+*/
+
+void cpu_tlb_shootdown(struct pagetable *pt)
+{
+	struct cpu *self;
+	int i;
+
+	if(cpu_count < 2)
+		return;
+
+	self = cpu_self();
+
+	for(i = 0; i < cpu_count; i++) {
+		struct cpu *c = &cpus[i];
+		if(c == self || !c->process || c->process->pagetable != pt)
+			continue;
+		c->tlb_flush = 1;
+		apic_send_ipi(c->apic_id, INTERRUPT_APIC_WAKE);
+	}
+
+	for(i = 0; i < cpu_count; i++) {
+		while(cpus[i].tlb_flush) {
+			asm volatile ("pause");
+		}
+	}
+}
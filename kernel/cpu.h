@@ -0,0 +1,61 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#ifndef CPU_H
+#define CPU_H
+
+#include "kernel/types.h"
+#include "x86.h"
+#include "memorylayout.h"
+
+struct process;
+struct spinlock;
+struct pagetable;
+
+/*
+The state private to each processor.  Entries are numbered in
+the order the CPUs were started, with the boot CPU at zero.
+*/
+
+struct cpu {
+	int id;
+	int apic_id;
+	volatile int started;
+	volatile int idle;
+	volatile int tlb_flush;
+	struct process *process;
+	struct process *prev;
+	int prev_state;
+	struct spinlock *prev_lock;
+	char *stack_top;
+	uint32_t sysenter_stack[16];
+	struct x86_tss tss;
+};
+
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_count;
+extern struct pagetable *cpu_idle_pagetable;
+extern int cpu_sysenter_enabled;
+
+void cpu_init();
+void cpu_start_all();
+void cpu_wake(struct cpu *c);
+void cpu_tlb_shootdown(struct pagetable *pt);
+
+/*
+Each CPU loads the task register with its own TSS slot in the GDT,
+so the slot number tells us which CPU we are on without
+touching the local APIC.
+*/
+
+static inline struct cpu *cpu_self()
+{
+	uint16_t selector;
+	asm volatile ("str %0":"=r"(selector));
+	return &cpus[(selector >> 3) - (X86_SEGMENT_TSS >> 3)];
+}
+
+#endif
@@ -76,7 +76,7 @@ If nothing available, return zero.
 
 static uint32_t diskfs_data_block_alloc( struct fs_volume *v )
 {
-	struct diskfs_block *b = page_alloc(0);
+	struct diskfs_block *b = page_alloc_tag(0, MEMORY_TAG_FS);
 	struct diskfs_superblock *s= &v->disk;
 	int i, j, k;
 
@@ -112,7 +112,7 @@ static uint32_t diskfs_data_block_alloc( struct fs_volume *v )
 
 static void diskfs_data_block_free( struct fs_volume *v, int blockno )
 {
-	struct diskfs_block *b = page_alloc(0);
+	struct diskfs_block *b = page_alloc_tag(0, MEMORY_TAG_FS);
 
 	int bitmap_block = blockno/DISKFS_BLOCK_SIZE;
 	int bitmap_byte = blockno%DISKFS_BLOCK_SIZE/8;
@@ -127,7 +127,7 @@ static void diskfs_data_block_free( struct fs_volume *v, int blockno )
 
 static int diskfs_inumber_alloc( struct fs_volume *v )
 {
-	struct diskfs_block *b = page_alloc(0);
+	struct diskfs_block *b = page_alloc_tag(0, MEMORY_TAG_FS);
 	int i, j;
 
 	for(i=0;i<v->disk.inode_blocks;i++) {
@@ -152,7 +152,7 @@ static int diskfs_inumber_alloc( struct fs_volume *v )
 static void diskfs_inumber_free( struct fs_volume *v, int inumber )
 {
 	int inode_block = inumber / DISKFS_INODES_PER_BLOCK;
-	struct diskfs_block *b = page_alloc(0);
+	struct diskfs_block *b = page_alloc_tag(0, MEMORY_TAG_FS);
 	diskfs_inode_block_read(v,b,inode_block);
 	b->inodes[inumber%DISKFS_INODES_PER_BLOCK].inuse = 0;
 	diskfs_inode_block_write(v,b,inode_block);
@@ -161,7 +161,7 @@ static void diskfs_inumber_free( struct fs_volume *v, int inumber )
 
 int diskfs_inode_load( struct fs_volume *v, int inumber, struct diskfs_inode *inode )
 {
-	struct diskfs_block *b = page_alloc(0);
+	struct diskfs_block *b = page_alloc_tag(0, MEMORY_TAG_FS);
 
 	int inode_block = inumber / DISKFS_INODES_PER_BLOCK;
 	int inode_position = inumber % DISKFS_INODES_PER_BLOCK;
@@ -176,7 +176,7 @@ int diskfs_inode_load( struct fs_volume *v, int inumber, struct diskfs_inode *in
 
 int diskfs_inode_save( struct fs_volume *v, int inumber, struct diskfs_inode *inode )
 {
-	struct diskfs_block *b = page_alloc(0);
+	struct diskfs_block *b = page_alloc_tag(0, MEMORY_TAG_FS);
 
 	int inode_block = inumber / DISKFS_INODES_PER_BLOCK;
 	int inode_position = inumber % DISKFS_INODES_PER_BLOCK;
@@ -219,7 +219,7 @@ int diskfs_inode_write( struct fs_dirent *d, struct diskfs_block *b, uint32_t bl
 			diskfs_inode_save(d->volume,d->inumber,i);	
 		}
 	} else {
-		struct diskfs_block *iblock = page_alloc(0);
+		struct diskfs_block *iblock = page_alloc_tag(0, MEMORY_TAG_FS);
 
 		if(i->indirect==0) {
 			actual = diskfs_data_block_alloc(d->volume);
@@ -252,7 +252,7 @@ int diskfs_inode_write( struct fs_dirent *d, struct diskfs_block *b, uint32_t bl
 
 struct fs_dirent * diskfs_dirent_create( struct fs_volume *volume, int inumber, int type )
 {
-	struct fs_dirent *d = kmalloc(sizeof(*d));
+	struct fs_dirent *d = kmalloc_tag(sizeof(*d), MEMORY_TAG_FS);
 	memset(d,0,sizeof(*d));
 
 	diskfs_inode_load(volume,inumber,&d->disk);
@@ -282,7 +282,7 @@ static int diskfs_name_equals( const char *a, int alength, const char *b, int bl
 
 struct fs_dirent * diskfs_dirent_lookup( struct fs_dirent *d, const char *name )
 {
-	struct diskfs_block *b = page_alloc(0);
+	struct diskfs_block *b = page_alloc_tag(0, MEMORY_TAG_FS);
 	int i, j;
 
 	int nblocks = d->size / DISKFS_BLOCK_SIZE;
@@ -308,7 +308,7 @@ struct fs_dirent * diskfs_dirent_lookup( struct fs_dirent *d, const char *name )
 
 int diskfs_dirent_list( struct fs_dirent *d, char *buffer, int length )
 {
-	struct diskfs_block *b = page_alloc(0);
+	struct diskfs_block *b = page_alloc_tag(0, MEMORY_TAG_FS);
 
 	int nblocks = d->size / DISKFS_BLOCK_SIZE;
 	if(d->size%DISKFS_BLOCK_SIZE) nblocks++;
@@ -350,7 +350,7 @@ int diskfs_dirent_resize( struct fs_dirent *d, uint32_t size )
 
 static int diskfs_dirent_add( struct fs_dirent *d, const char *name, int type, int inumber )
 {
-	struct diskfs_block *b = page_alloc(0);
+	struct diskfs_block *b = page_alloc_tag(0, MEMORY_TAG_FS);
 	int i, j;
 
 	int nblocks = d->size / DISKFS_BLOCK_SIZE;
@@ -446,7 +446,7 @@ void diskfs_inode_delete( struct fs_volume *v, struct diskfs_inode *node, int in
 	}
 
 	if(size<node->size) {
-		struct diskfs_block *b = page_alloc(0);
+		struct diskfs_block *b = page_alloc_tag(0, MEMORY_TAG_FS);
 		diskfs_data_block_read(v,b,node->indirect);
 		for(i=0;i<DISKFS_POINTERS_PER_BLOCK;i++) {
 			diskfs_data_block_free(v,b->pointers[i]);
@@ -463,7 +463,7 @@ void diskfs_inode_delete( struct fs_volume *v, struct diskfs_inode *node, int in
 
 int diskfs_dirent_remove( struct fs_dirent *d, const char *name )
 {
-	struct diskfs_block *b = page_alloc(0);
+	struct diskfs_block *b = page_alloc_tag(0, MEMORY_TAG_FS);
 
 	int name_length = strlen(name);
 
@@ -514,7 +514,7 @@ extern struct fs disk_fs;
 
 struct fs_volume * diskfs_volume_open( struct device *device )
 {
-	struct diskfs_block *b = page_alloc(0);
+	struct diskfs_block *b = page_alloc_tag(0, MEMORY_TAG_FS);
 
 	printf("diskfs: opening device %s unit %d\n",device_name(device),device_unit(device));
 
@@ -528,7 +528,7 @@ struct fs_volume * diskfs_volume_open( struct device *device )
 		return 0;
 	}
 
-       	struct fs_volume *v = kmalloc(sizeof(*v));
+       	struct fs_volume *v = kmalloc_tag(sizeof(*v), MEMORY_TAG_FS);
 	v->fs = &disk_fs;
 	v->device = device;
 	v->block_size = device_block_size(device);
@@ -557,7 +557,7 @@ int diskfs_volume_close( struct fs_volume *v )
 
 int diskfs_volume_format( struct device *device )
 {
-	struct diskfs_block *b = page_alloc(1);
+	struct diskfs_block *b = page_alloc_tag(1, MEMORY_TAG_FS);
 	struct diskfs_superblock sb;
 
 	int nblocks = device_nblocks(device);
@@ -11,6 +11,10 @@ See the file LICENSE for details.
 #include "process.h"
 #include "kernel/syscall.h"
 #include "memorylayout.h"
+#include "fs_internal.h"
+#include "pagetable.h"
+#include "kmalloc.h"
+#include "page.h"
 
 struct elf_header {
 	char ident[16];
@@ -101,7 +105,7 @@ static int elf_ensure_address_space( struct process *p, uint32_t addr )
 	limit += (PAGE_SIZE-overflow);
 
 	/* Extend virtual memory if needed. */
-	if(limit > p->vm_data_size) {
+	if(limit > p->space->vm_data_size) {
 		return process_data_size_set(p,limit);
 	} else {
 		return 0;
@@ -110,7 +114,7 @@ static int elf_ensure_address_space( struct process *p, uint32_t addr )
 	/* Return zero on success. */
 }
  
-int elf_load(struct process *p, struct fs_dirent *d, addr_t * entry)
+static int elf_load_copy(struct process *p, struct fs_dirent *d, addr_t * entry)
 {
 	struct elf_header header;
 	struct elf_program program;
@@ -180,3 +184,290 @@ int elf_load(struct process *p, struct fs_dirent *d, addr_t * entry)
 	printf("elf: did not load correctly\n");
 	return KERROR_EXECUTION_FAILED;
 }
+
+/*
+Programs that are run over and over (the shell, the basic tools)
+are kept in a small cache of loaded images, keyed by the volume,
+inode, and size of the executable.  Each process maps the pages
+of an image read-only and copy-on-write, so the text is shared by
+every process running that program, and a data page is copied
+only when a process first writes to it.  An image is dropped from
+the cache when its file is written or removed, but lives on for
+as long as some process still maps it.
+*/
+
+#define ELF_CACHE_MAX 8
+
+struct elf_image {
+	struct elf_image *next;
+	struct fs_volume *volume;
+	int inumber;
+	uint32_t size;
+	uint32_t vaddr;
+	uint32_t npages;
+	uint32_t data_end;
+	addr_t entry;
+	int refcount;
+	uint32_t last_used;
+	char **pages;
+};
+
+static struct elf_image *elf_cache = 0;
+static int elf_cache_count = 0;
+static uint32_t elf_cache_clock = 0;
+
+struct elf_image *elf_image_addref(struct elf_image *img)
+{
+	if(img) img->refcount++;
+	return img;
+}
+
+void elf_image_release(struct elf_image *img)
+{
+	uint32_t i;
+
+	if(!img) return;
+	img->refcount--;
+	if(img->refcount > 0) return;
+
+	for(i = 0; i < img->npages; i++) {
+		if(img->pages[i]) page_free(img->pages[i]);
+	}
+	kfree(img->pages);
+	kfree(img);
+}
+
+static void elf_cache_unlink(struct elf_image *img)
+{
+	struct elf_image **prev;
+
+	for(prev = &elf_cache; *prev; prev = &(*prev)->next) {
+		if(*prev == img) {
+			*prev = img->next;
+			img->next = 0;
+			elf_cache_count--;
+			elf_image_release(img);
+			return;
+		}
+	}
+}
+
+void elf_cache_invalidate(struct fs_volume *v, int inumber)
+{
+	struct elf_image *img, *next;
+
+	for(img = elf_cache; img; img = next) {
+		next = img->next;
+		if(img->volume == v && (inumber < 0 || img->inumber == inumber)) {
+			elf_cache_unlink(img);
+		}
+	}
+}
+
+static struct elf_image *elf_cache_lookup(struct fs_dirent *d)
+{
+	struct elf_image *img;
+
+	for(img = elf_cache; img; img = img->next) {
+		if(img->volume == d->volume && img->inumber == d->inumber && img->size == d->size) {
+			img->last_used = ++elf_cache_clock;
+			return img;
+		}
+	}
+	return 0;
+}
+
+/*
+Make room for one more image by evicting the least recently used
+one, preferring images that no process currently maps.
+*/
+
+static void elf_cache_make_room()
+{
+	struct elf_image *img, *victim = 0;
+
+	if(elf_cache_count < ELF_CACHE_MAX) return;
+
+	for(img = elf_cache; img; img = img->next) {
+		int idle = img->refcount == 1;
+		int victim_idle = victim && victim->refcount == 1;
+		if(!victim || (idle && !victim_idle) || (idle == victim_idle && img->last_used < victim->last_used)) {
+			victim = img;
+		}
+	}
+
+	if(victim) elf_cache_unlink(victim);
+}
+
+/* Read length bytes at file offset into the image at address vaddr, page by page. */
+
+static int elf_image_read(struct elf_image *img, struct fs_dirent *d, uint32_t vaddr, uint32_t length, uint32_t offset)
+{
+	while(length > 0) {
+		uint32_t index = (vaddr - img->vaddr) / PAGE_SIZE;
+		uint32_t pageoffset = vaddr % PAGE_SIZE;
+		uint32_t chunk = MIN(length, PAGE_SIZE - pageoffset);
+
+		if(fs_dirent_read(d, img->pages[index] + pageoffset, chunk, offset) != chunk)
+			return 0;
+
+		vaddr += chunk;
+		offset += chunk;
+		length -= chunk;
+	}
+	return 1;
+}
+
+/*
+Build a cached image of the executable, following the same rules
+as elf_load_copy.  Returns null if the file cannot be cached for
+any reason, in which case the caller falls back to loading it
+directly, and reports any error from there.
+*/
+
+static struct elf_image *elf_image_create(struct fs_dirent *d)
+{
+	struct elf_header header;
+	struct elf_program program;
+	struct elf_section section;
+	struct elf_image *img = 0;
+	uint32_t end, data_end;
+	int i;
+
+	if(fs_dirent_read(d, (char *) &header, sizeof(header), 0) != sizeof(header))
+		return 0;
+
+	if(strncmp(header.ident, "\177ELF", 4) || header.machine != ELF_HEADER_MACHINE_I386 || header.version != ELF_HEADER_VERSION)
+		return 0;
+
+	if(fs_dirent_read(d, (char *) &program, sizeof(program), header.program_offset) != sizeof(program))
+		return 0;
+
+	if(program.type != ELF_PROGRAM_TYPE_LOADABLE || program.vaddr != PROCESS_ENTRY_POINT || program.memory_size > 0x8000000 || program.memory_size != program.file_size)
+		return 0;
+
+	/* First pass: find the extent of everything that must be loaded from the file. */
+
+	end = data_end = program.vaddr + program.memory_size;
+
+	for(i = 0; i < header.shnum; i++) {
+		if(fs_dirent_read(d, (char *) &section, sizeof(section), header.section_offset + i * header.shentsize) != sizeof(section))
+			return 0;
+		if(section.type == ELF_SECTION_TYPE_PROGRAM && section.address != 0) {
+			if(section.address < program.vaddr || section.address + section.size > PROCESS_ENTRY_POINT + 0x8000000)
+				return 0;
+			end = MAX(end, section.address + section.size);
+		}
+		if(section.type == ELF_SECTION_TYPE_BSS || (section.type == ELF_SECTION_TYPE_PROGRAM && section.address != 0)) {
+			data_end = MAX(data_end, section.address + section.size);
+		}
+	}
+
+	img = kmalloc_tag(sizeof(*img), MEMORY_TAG_PROCESS);
+	if(!img) return 0;
+	memset(img, 0, sizeof(*img));
+
+	img->volume = d->volume;
+	img->inumber = d->inumber;
+	img->size = d->size;
+	img->vaddr = program.vaddr;
+	img->npages = (end - program.vaddr + PAGE_SIZE - 1) / PAGE_SIZE;
+	img->data_end = data_end;
+	img->entry = header.entry;
+	img->refcount = 1;
+
+	img->pages = kmalloc_tag(img->npages * sizeof(char *), MEMORY_TAG_PROCESS);
+	if(!img->pages) {
+		kfree(img);
+		return 0;
+	}
+	memset(img->pages, 0, img->npages * sizeof(char *));
+
+	for(i = 0; i < (int) img->npages; i++) {
+		img->pages[i] = page_alloc_tag(1, MEMORY_TAG_USER);
+		if(!img->pages[i]) goto fail;
+	}
+
+	/* Second pass: fill the pages exactly as elf_load_copy would. */
+
+	if(!elf_image_read(img, d, program.vaddr, program.memory_size, program.offset))
+		goto fail;
+
+	for(i = 0; i < header.shnum; i++) {
+		if(fs_dirent_read(d, (char *) &section, sizeof(section), header.section_offset + i * header.shentsize) != sizeof(section))
+			goto fail;
+		if(section.type == ELF_SECTION_TYPE_PROGRAM && section.address != 0) {
+			if(!elf_image_read(img, d, section.address, section.size, section.offset))
+				goto fail;
+		}
+	}
+
+	return img;
+
+      fail:
+	elf_image_release(img);
+	return 0;
+}
+
+/*
+Replace the user data area of the process with a copy-on-write
+mapping of the image, then reserve zeroed pages for the BSS.
+*/
+
+static int elf_image_map(struct process *p, struct elf_image *img)
+{
+	uint32_t i;
+	uint32_t limit;
+
+	process_data_size_set(p, 0);
+
+	for(i = 0; i < img->npages; i++) {
+		if(!pagetable_map(p->pagetable, img->vaddr + i * PAGE_SIZE, (unsigned) img->pages[i], PAGE_FLAG_USER | PAGE_FLAG_READONLY | PAGE_FLAG_COPY)) {
+			process_data_size_set(p, 0);
+			return KERROR_OUT_OF_MEMORY;
+		}
+	}
+
+	limit = img->data_end - PROCESS_ENTRY_POINT;
+	if(limit % PAGE_SIZE) limit += PAGE_SIZE - limit % PAGE_SIZE;
+
+	if(process_data_size_set(p, limit) != 0) {
+		process_data_size_set(p, 0);
+		return KERROR_OUT_OF_MEMORY;
+	}
+
+	elf_image_release(p->space->image);
+	p->space->image = elf_image_addref(img);
+	return 0;
+}
+
+int elf_load(struct process *p, struct fs_dirent *d, addr_t * entry)
+{
+	struct elf_image *img = elf_cache_lookup(d);
+
+	if(!img) {
+		img = elf_image_create(d);
+		if(img) {
+			elf_cache_make_room();
+			img->last_used = ++elf_cache_clock;
+			img->next = elf_cache;
+			elf_cache = img;
+			elf_cache_count++;
+		}
+	}
+
+	if(img && elf_image_map(p, img) == 0) {
+		*entry = img->entry;
+		return 0;
+	}
+
+	/* Otherwise load a private copy, discarding any shared image. */
+
+	if(p->space->image) {
+		process_data_size_set(p, 0);
+		elf_image_release(p->space->image);
+		p->space->image = 0;
+	}
+
+	return elf_load_copy(p, d, entry);
+}
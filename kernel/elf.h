@@ -20,4 +20,14 @@ entry point value in the current process structure.
 
 int elf_load(struct process *p, struct fs_dirent *d, addr_t * entry);
 
+/*
+Loaded images are cached and shared copy-on-write between
+processes.  A process holds a reference to the image it maps,
+and the cache entries for a file are dropped when it changes.
+*/
+
+struct elf_image *elf_image_addref(struct elf_image *img);
+void elf_image_release(struct elf_image *img);
+void elf_cache_invalidate(struct fs_volume *v, int inumber);
+
 #endif
@@ -52,7 +52,7 @@ int event_read_raw( struct event *e, int size, int blocking )
 
 		if(head==tail) {
 			if(blocking && total==0) {
-				process_wait(&queue);
+				process_wait_interactive(&queue,-1);
 				continue;
 			} else {
 				break;
@@ -3,12 +3,14 @@
 #include "process.h"
 #include "list.h"
 #include "kmalloc.h"
+#include "poll.h"
 
 #define EVENT_BUFFER_SIZE 32
 
 struct event_queue {
 	struct event buffer[EVENT_BUFFER_SIZE];
 	struct list process_queue;
+	struct list pollers;
 	int head;
 	int tail;
 	int overflow_count;
@@ -51,6 +53,7 @@ void event_queue_post( struct event_queue *q, struct event *e )
 	/* Advance head pointer and wake up waiting process (if any) */
 	q->head = next;
 	process_wakeup(&q->process_queue);
+	poll_notify(&q->pollers);
 }
 
 /* INTERRUPT CONTEXT */
@@ -65,7 +68,12 @@ void event_queue_post_root( uint16_t type, uint16_t code, int16_t x, int16_t y )
 	event_queue_post(&event_queue_root,&e);
 }
 
-static int event_queue_read_raw( struct event_queue *q, struct event *e, int size, int blocking )
+/*
+Read events, blocking for up to timeout milliseconds for the first
+one to arrive: zero does not block and a negative timeout waits forever.
+*/
+
+static int event_queue_read_raw( struct event_queue *q, struct event *e, int size, int timeout )
 {
 	int total=0;
 
@@ -76,8 +84,8 @@ static int event_queue_read_raw( struct event_queue *q, struct event *e, int siz
 	while(size>=sizeof(struct event)) {
 
 		if(q->head==q->tail) {
-			if(blocking && total==0) {
-				process_wait(&q->process_queue);
+			if(timeout!=0 && total==0) {
+				if(process_wait_interactive(&q->process_queue,timeout)) break;
 				continue;
 			} else {
 				break;
@@ -96,9 +104,42 @@ static int event_queue_read_raw( struct event_queue *q, struct event *e, int siz
 	return total;
 }
 
+/*
+Return true if an event of the given type (or any type, if zero)
+is waiting.  The queue is only looked at, not changed, since other
+readers of the same queue may want the events of other types.
+If w is given, it is hung on the queue to be woken by the next event.
+*/
+
+int event_queue_poll( struct event_queue *q, uint16_t type, struct poll_waiter *w )
+{
+	int ready = 0;
+	int i;
+
+	int enabled = interrupt_block_save();
+
+	for(i=q->tail;i!=q->head;i=(i+1)%EVENT_BUFFER_SIZE) {
+		if(!type || q->buffer[i].type==type) {
+			ready = 1;
+			break;
+		}
+	}
+
+	if(w) poll_register(&q->pollers,w);
+
+	interrupt_restore(enabled);
+
+	return ready;
+}
+
 int event_queue_read( struct event_queue *q, struct event *e, int size )
 {
-	return event_queue_read_raw(q,e,size,1);
+	return event_queue_read_raw(q,e,size,-1);
+}
+
+int event_queue_read_timeout( struct event_queue *q, struct event *e, int size, int timeout )
+{
+	return event_queue_read_raw(q,e,size,timeout);
 }
 
 int event_queue_read_nonblock( struct event_queue *q, struct event *e, int size )
@@ -13,7 +13,11 @@ void event_queue_delete( struct event_queue *e);
 void event_queue_post( struct event_queue *q, struct event *e );
 int  event_queue_read( struct event_queue *q, struct event *e, int size );
 int  event_queue_read_nonblock( struct event_queue *q, struct event *e, int size );
+int  event_queue_read_timeout( struct event_queue *q, struct event *e, int size, int timeout );
 
 void event_queue_post_root( uint16_t type, uint16_t code, int16_t x, int16_t y );
 
+struct poll_waiter;
+int  event_queue_poll( struct event_queue *q, uint16_t type, struct poll_waiter *w );
+
 #endif
@@ -6,11 +6,13 @@ See the file LICENSE for details.
 
 #include "fs.h"
 #include "fs_internal.h"
+#include "elf.h"
 #include "kmalloc.h"
 #include "string.h"
 #include "page.h"
 #include "process.h"
 #include "bcache.h"
+#include "is_valid.h"
 
 static struct fs *fs_list = 0;
 
@@ -21,12 +23,12 @@ static struct kobject * find_kobject_by_tag( const char *tag )
 	// Check if tag is index-specified.
 	if(tag[0] == '#') {
 		str2int(&tag[1], &i);
-		return current->ktable[i];
+		return is_valid_object(i) ? current->space->ktable[i] : 0;
 	} else {
 		// Find an tag matching the tag.
 		int max = process_object_max(current);
-		for(i=0;i<max;i++) {
-			struct kobject *k = current->ktable[i];
+		for(i=0;i<=max;i++) {
+			struct kobject *k = current->space->ktable[i];
 			if(k && !strcmp(k->tag,tag)) {
 				return k;
 			}
@@ -38,7 +40,7 @@ static struct kobject * find_kobject_by_tag( const char *tag )
 
 struct fs_dirent * fs_getroot( struct process *p )
 {
-	struct kobject *k = p->ktable[KNO_STDDIR];
+	struct kobject *k = p->space->ktable[KNO_STDDIR];
 	if( k && k->type==KOBJECT_DIR ) {
 		return k->data.dir;
 	} else {
@@ -48,7 +50,7 @@ struct fs_dirent * fs_getroot( struct process *p )
 
 struct fs_dirent * fs_getcurrent( struct process *p )
 {
-	struct kobject *k = p->ktable[KNO_STDDIR];
+	struct kobject *k = p->space->ktable[KNO_STDDIR];
 	if( k && k->type==KOBJECT_DIR ) {
 		return k->data.dir;
 	} else {
@@ -152,6 +154,7 @@ int fs_volume_close(struct fs_volume *v)
 
 	v->refcount--;
 	if(v->refcount==0) {
+		elf_cache_invalidate(v, -1);
 		v->fs->ops->volume_close(v);
 		bcache_flush_device(v->device);
 		device_close(v->device);
@@ -202,7 +205,7 @@ struct fs_dirent *fs_dirent_traverse(struct fs_dirent *parent, const char *path)
 	if(!parent || !path)
 		return 0;
 
-	char *lpath = kmalloc(strlen(path) + 1);
+	char *lpath = kmalloc_tag(strlen(path) + 1, MEMORY_TAG_FS);
 	strcpy(lpath, path);
 
 	struct fs_dirent *d = parent;
@@ -265,7 +268,7 @@ int fs_dirent_read(struct fs_dirent *d, char *buffer, uint32_t length, uint32_t
 		length = d->size - offset;
 	}
 
-	char *temp = page_alloc(0);
+	char *temp = page_alloc_tag(0, MEMORY_TAG_FS);
 	if(!temp)
 		return -1;
 
@@ -341,6 +344,8 @@ int fs_dirent_remove(struct fs_dirent *d, const char *name)
 	const struct fs_ops *ops = d->volume->fs->ops;
 	if(!ops->remove)
 		return 0;
+	// the removed file's inode is not known here, so drop every image on the volume
+	elf_cache_invalidate(d->volume, -1);
 	return ops->remove(d, name);
 }
 
@@ -353,7 +358,9 @@ int fs_dirent_write(struct fs_dirent *d, const char *buffer, uint32_t length, ui
 	if(!ops->write_block || !ops->read_block)
 		return KERROR_INVALID_REQUEST;
 
-	char *temp = page_alloc(0);
+	elf_cache_invalidate(d->volume, d->inumber);
+
+	char *temp = page_alloc_tag(0, MEMORY_TAG_FS);
 
 	// if writing past the (current) end of the file, resize the file first
 	if (offset + length > d->size) {
@@ -422,7 +429,7 @@ int fs_dirent_isdir( struct fs_dirent *d )
 
 int fs_dirent_copy(struct fs_dirent *src, struct fs_dirent *dst, int depth )
 {
-	char *buffer = page_alloc(1);
+	char *buffer = page_alloc_tag(1, MEMORY_TAG_FS);
 
 	int length = fs_dirent_list(src, buffer, PAGE_SIZE);
 	if (length <= 0) goto failure;
@@ -464,7 +471,7 @@ int fs_dirent_copy(struct fs_dirent *src, struct fs_dirent *dst, int depth )
 				goto next_entry;
 			}
 
-			char * filebuf = page_alloc(0);
+			char * filebuf = page_alloc_tag(0, MEMORY_TAG_FS);
 			if (!filebuf) {
 				fs_dirent_close(new_src);
 				fs_dirent_close(new_dst);
@@ -0,0 +1,128 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#include "futex.h"
+#include "process.h"
+#include "pagetable.h"
+#include "interrupt.h"
+#include "spinlock.h"
+#include "clock.h"
+#include "memorylayout.h"
+#include "kernel/error.h"
+
+#define FUTEX_BUCKETS 64
+
+struct futex_bucket {
+	struct spinlock lock;
+	struct list waiters;
+};
+
+static struct futex_bucket futex_table[FUTEX_BUCKETS];
+
+/*
+Find the physical address of a user word, touching it first
+so that a page not yet faulted in is mapped.  The touch is an
+atomic write of nothing, so that a copy-on-write page is made
+private before its address is used as the key.
+*/
+
+static int futex_key(uint32_t *addr, uint32_t *key)
+{
+	unsigned paddr;
+
+	if((uint32_t) addr < PROCESS_ENTRY_POINT || (uint32_t) addr % sizeof(uint32_t))
+		return KERROR_INVALID_ADDRESS;
+
+	__sync_fetch_and_add(addr, 0);
+
+	if(!pagetable_getmap(current->pagetable, (unsigned) addr, &paddr, 0))
+		return KERROR_INVALID_ADDRESS;
+
+	*key = paddr;
+	return 0;
+}
+
+static struct futex_bucket *futex_bucket(uint32_t key)
+{
+	return &futex_table[(key >> 2) % FUTEX_BUCKETS];
+}
+
+/*
+Sleep until woken, if *addr still holds expected once the bucket
+is locked, so that a wakeup between the caller's test and this
+call is not lost.  Gives up after millis, unless it is negative.
+*/
+
+int futex_wait(uint32_t *addr, uint32_t expected, int millis)
+{
+	struct futex_bucket *b;
+	uint32_t key;
+	int r;
+
+	r = futex_key(addr, &key);
+	if(r < 0)
+		return r;
+
+	b = futex_bucket(key);
+
+	interrupt_block();
+	spinlock_acquire(&b->lock);
+
+	if(*addr != expected) {
+		spinlock_release(&b->lock);
+		interrupt_unblock();
+		return KERROR_TRY_AGAIN;
+	}
+
+	current->futex_key = key;
+	if(millis >= 0)
+		clock_timer_start(&current->timer, current, millis);
+
+	process_wait_locked(&b->waiters, &b->lock);
+
+	if(millis >= 0) {
+		clock_timer_cancel(&current->timer);
+		if(current->timer.expired)
+			return KERROR_TIMED_OUT;
+	}
+
+	return 0;
+}
+
+/* Wake up to count waiters on addr, and return how many were woken. */
+
+int futex_wake(uint32_t *addr, int count)
+{
+	struct futex_bucket *b;
+	struct process *p, *next;
+	uint32_t key;
+	int woken = 0;
+	int r;
+
+	r = futex_key(addr, &key);
+	if(r < 0)
+		return r;
+
+	b = futex_bucket(key);
+
+	interrupt_block();
+	spinlock_acquire(&b->lock);
+
+	p = (struct process *) b->waiters.head;
+	while(p && woken < count) {
+		next = (struct process *) p->node.next;
+		if(p->futex_key == key) {
+			process_unblock(p);
+			woken++;
+		}
+		p = next;
+	}
+
+	spinlock_release(&b->lock);
+	interrupt_unblock();
+
+	return woken;
+}
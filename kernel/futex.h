@@ -0,0 +1,21 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include "kernel/types.h"
+
+/*
+A futex lets user code sleep until a word of its memory changes.
+Waiters are keyed by the physical address of the word, so that
+processes sharing memory at different addresses find each other.
+*/
+
+int futex_wait(uint32_t *addr, uint32_t expected, int millis);
+int futex_wake(uint32_t *addr, int count);
+
+#endif
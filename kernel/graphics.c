@@ -55,7 +55,7 @@ struct graphics *graphics_create_root()
 
 struct graphics *graphics_create(struct graphics *parent )
 {
-	struct graphics *g = kmalloc(sizeof(*g));
+	struct graphics *g = kmalloc_tag(sizeof(*g), MEMORY_TAG_GRAPHICS);
 	if(!g) return 0;
 
 	memcpy(g, parent, sizeof(*g));
@@ -7,13 +7,16 @@ See the file LICENSE for details.
 #include "interrupt.h"
 #include "console.h"
 #include "pic.h"
+#include "apic.h"
+#include "spinlock.h"
 #include "process.h"
 #include "kernelcore.h"
 #include "x86.h"
+#include "memorylayout.h"
 
-static interrupt_handler_t interrupt_handler_table[48];
-static uint32_t interrupt_count[48];
-static uint8_t interrupt_spurious[48];
+static interrupt_handler_t interrupt_handler_table[INTERRUPT_MAX];
+static uint32_t interrupt_count[INTERRUPT_MAX];
+static uint8_t interrupt_spurious[INTERRUPT_MAX];
 
 static const char *exception_names[] = {
 	"division by zero",
@@ -42,20 +45,34 @@ static void unknown_exception(int i, int code)
 	unsigned esp; // stack pointer
 
 	if(i==14) {
-		asm("mov %%cr2, %0" : "=r" (vaddr) ); // virtual address trying to be accessed		
+		asm("mov %%cr2, %0" : "=r" (vaddr) ); // virtual address trying to be accessed
 		esp  = ((struct x86_stack *)(current->kstack_top - sizeof(struct x86_stack)))->esp; // stack pointer of the process that raised the exception
-		// Check if the requested memory is in the stack or data
-		int data_access = vaddr < current->vm_data_size;
 
+		// Check if the requested memory is in the reserved data segment (heap)
+		int data_access = vaddr >= PROCESS_ENTRY_POINT && vaddr - PROCESS_ENTRY_POINT < current->space->vm_data_size;
+
+		// Or within the stack: either the reserved stack area, or just below the stack pointer.
 		// Subtract 128 from esp because of the red-zone 
 		// According to https:gcc.gnu.org, the red zone is a 128-byte area beyond 
 		// the stack pointer that will not be modified by signal or interrupt handlers 
 		// and therefore can be used for temporary data without adjusting the stack pointer.
-		int stack_access = vaddr >= esp - 128; 
+		uint32_t stack_bottom = 0 - current->space->vm_stack_size;
+		int stack_access = vaddr >= PROCESS_STACK_LIMIT && ((current->space->vm_stack_size && vaddr >= stack_bottom) || vaddr >= esp - 128);
 
 		// Check if the requested memory is already in use
 		int page_already_present = pagetable_getmap(current->pagetable,vaddr,&paddr,0);
-		
+
+		// Another thread of this process may have mapped the page since we faulted on
+		// its absence (bit 0 of the code is clear), in which case just try again.
+		if (page_already_present && !(code & 1)) {
+			return;
+		}
+
+		// A write (bit 1) to a shared copy-on-write page just needs a private copy.
+		if (page_already_present && (code & 2) && pagetable_copy_on_write(current->pagetable, vaddr)) {
+			return;
+		}
+
 		// Check if page is already mapped (which will result from violating the permissions on page) or that
 		// we are accessing neither the stack nor the heap, or we are accessing both. If so, error
 		if (page_already_present || !(data_access ^ stack_access)) {
@@ -63,8 +80,11 @@ static void unknown_exception(int i, int code)
 			process_dump(current);
 			process_exit(0);
 		} else {
-			// XXX update process->vm_stack_size when growing the stack.
+			// Demand-zero: map a cleared page on first touch.
 			pagetable_alloc(current->pagetable, vaddr, PAGE_SIZE, PAGE_FLAG_USER | PAGE_FLAG_READWRITE | PAGE_FLAG_CLEAR);
+			if(stack_access && vaddr < stack_bottom) {
+				current->space->vm_stack_size = 0 - (vaddr & PAGE_MASK);
+			}
 			return;
 		}
 	} else {
@@ -97,8 +117,10 @@ static void interrupt_acknowledge(int i)
 {
 	if(i < 32) {
 		/* do nothing */
-	} else {
+	} else if(i < INTERRUPT_SYSCALL) {
 		pic_acknowledge(i - 32);
+	} else if(i != INTERRUPT_APIC_SPURIOUS) {
+		apic_eoi();
 	}
 }
 
@@ -115,7 +137,7 @@ void interrupt_init()
 		interrupt_spurious[i] = 0;
 		interrupt_count[i] = 0;
 	}
-	for(i = 32; i < 48; i++) {
+	for(i = 32; i < INTERRUPT_MAX; i++) {
 		interrupt_handler_table[i] = unknown_hardware;
 		interrupt_spurious[i] = 0;
 		interrupt_count[i] = 0;
@@ -126,16 +148,47 @@ void interrupt_init()
 	printf("interrupt: ready\n");
 }
 
+/*
+The interrupt number and code are the last two words pushed
+by intr_handler, so the saved registers begin just above them.
+Use the saved code segment to tell whether user mode was interrupted.
+*/
+
+static int interrupt_from_user(int *code)
+{
+	struct x86_stack *s = (struct x86_stack *) ((char *) (code + 1) - (int) &((struct x86_stack *) 0)->regs1);
+	return (s->cs & 3) == 3;
+}
+
 void interrupt_handler(int i, int code)
 {
+	int from_user = interrupt_from_user(&code);
+
+	kernel_lock_acquire();
+
+	if(from_user)
+		process_enter_kernel();
+
 	(interrupt_handler_table[i]) (i, code);
 	interrupt_acknowledge(i);
 	interrupt_count[i]++;
+
+	/*
+	Only switch on the way back out to user mode,
+	since the kernel is not safe for preemption.
+	*/
+
+	if(from_user) {
+		process_preempt();
+		process_leave_kernel();
+	}
+
+	kernel_lock_release();
 }
 
 void interrupt_enable(int i)
 {
-	if(i < 32) {
+	if(i < 32 || i >= INTERRUPT_SYSCALL) {
 		/* do nothing */
 	} else {
 		pic_enable(i - 32);
@@ -144,7 +197,7 @@ void interrupt_enable(int i)
 
 void interrupt_disable(int i)
 {
-	if(i < 32) {
+	if(i < 32 || i >= INTERRUPT_SYSCALL) {
 		/* do nothing */
 	} else {
 		pic_disable(i - 32);
@@ -161,6 +214,24 @@ void interrupt_unblock()
 	asm("sti");
 }
 
+/*
+Block interrupts, and return whether they were enabled before,
+for code that may be called either way.
+*/
+
+int interrupt_block_save()
+{
+	uint32_t flags;
+	asm volatile ("pushfl; popl %0; cli":"=r"(flags));
+	return (flags & 0x200) != 0;
+}
+
+void interrupt_restore(int enabled)
+{
+	if(enabled)
+		interrupt_unblock();
+}
+
 void interrupt_wait()
 {
 	asm("sti");
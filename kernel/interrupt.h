@@ -15,8 +15,16 @@ void interrupt_enable(int i);
 void interrupt_disable(int i);
 void interrupt_block();
 void interrupt_unblock();
+int  interrupt_block_save();
+void interrupt_restore(int enabled);
 void interrupt_wait();
 
+#define INTERRUPT_SYSCALL      48
+#define INTERRUPT_APIC_TIMER   49
+#define INTERRUPT_APIC_WAKE    50
+#define INTERRUPT_APIC_SPURIOUS 63
+#define INTERRUPT_MAX          64
+
 /*
 PC Interrupts:
 IRQ	Interrupt
@@ -36,6 +44,9 @@ IRQ	Interrupt
 13	45	FPU
 14	46	ATA 0
 15	47	ATA 1
+
+Above those, 48 is the system call, and the local APIC of each
+CPU delivers its own timer, wakeup and spurious interrupts.
 */
 
 
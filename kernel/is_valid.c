@@ -80,13 +80,13 @@ int is_valid_location(const char * s)
 // Return true if file desciptor is in range and refers to a live object.
 int is_valid_object( int fd )
 {
-	return fd>=0 && fd<PROCESS_MAX_OBJECTS && current->ktable[fd];
+	return fd>=0 && fd<current->space->ktable_size && current->space->ktable[fd];
 }
 
 // Return true if fd valid and object is also of indicated type.
 int is_valid_object_type( int fd, kobject_type_t type )
 {
-	return is_valid_object(fd) && kobject_get_type(current->ktable[fd])==type;
+	return is_valid_object(fd) && kobject_get_type(current->space->ktable[fd])==type;
 }
 
 // Return true if (ptr,length) describes a valid area in user space.
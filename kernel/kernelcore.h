@@ -8,6 +8,7 @@ See the file LICENSE for details.
 #define KERNELCORE_H
 
 #include "kernel/types.h"
+#include "x86.h"
 
 extern uint16_t video_xbytes;
 extern uint16_t video_xres;
@@ -21,7 +22,11 @@ extern void halt();
 extern void reboot();
 
 extern void intr_return();
+extern void sysenter_entry();
 
-extern void *interrupt_stack_pointer;
+extern struct x86_segment gdt[];
+
+extern char cpu_trampoline[];
+extern char cpu_trampoline_end[];
 
 #endif
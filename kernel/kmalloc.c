@@ -8,14 +8,33 @@ See the file LICENSE for details.
 #include "console.h"
 #include "kernel/types.h"
 #include "memorylayout.h"
+#include "page.h"
+#include "memtrace.h"
 
 #define KUNIT sizeof(struct kmalloc_chunk)
 
-#define KMALLOC_STATE_FREE 0xa1a1a1a1
-#define KMALLOC_STATE_USED 0xbfbfbfbf
+#define KMALLOC_STATE_FREE 0xa1a1
+#define KMALLOC_STATE_USED 0xbfbf
+#define KMALLOC_STATE_PAGES 0xc5c5
+
+/*
+Allocations that need more than this size, once rounded up
+and given their chunk header, bypass the chunk list and are
+served directly as a run of pages from the page allocator.
+*/
+
+#define KMALLOC_LARGE PAGE_SIZE
+
+/*
+When the chunk list is exhausted, grow it by this many pages
+at a time, so that small allocations do not each cost a page.
+*/
+
+#define KMALLOC_GROW_PAGES 16
 
 struct kmalloc_chunk {
-	int state;
+	uint16_t state;
+	uint16_t tag;
 	int length;
 	struct kmalloc_chunk *next;
 	struct kmalloc_chunk *prev;
@@ -23,6 +42,34 @@ struct kmalloc_chunk {
 
 static struct kmalloc_chunk *head = 0;
 
+static int kmalloc_bytes[MEMORY_TAG_MAX];
+static int kmalloc_peak[MEMORY_TAG_MAX];
+static int kmalloc_count[MEMORY_TAG_MAX];
+
+/*
+Charge (or credit, when length is negative) a chunk to its
+owner, and note it in the trace ring, if enabled.
+*/
+
+static void kcharge(struct kmalloc_chunk *c, int length, void *site)
+{
+	kmalloc_bytes[c->tag] += length;
+	kmalloc_count[c->tag] += length > 0 ? 1 : -1;
+	if(kmalloc_bytes[c->tag] > kmalloc_peak[c->tag])
+		kmalloc_peak[c->tag] = kmalloc_bytes[c->tag];
+	memtrace_record(MEMORY_TRACE_KMALLOC, c->tag, site, c + 1, length);
+}
+
+void kmalloc_stats(struct memory_stats *s)
+{
+	int i;
+	for(i = 0; i < MEMORY_TAG_MAX; i++) {
+		s->kmalloc_bytes[i] = kmalloc_bytes[i];
+		s->kmalloc_peak[i] = kmalloc_peak[i];
+		s->kmalloc_count[i] = kmalloc_count[i];
+	}
+}
+
 /*
 Initialize the linked list by creating a single chunk at
 a given start address and length.  The chunk is initially
@@ -59,14 +106,93 @@ static void ksplit(struct kmalloc_chunk *c, int length)
 	c->length = length;
 }
 
+/*
+Pull a new region of pages from the page allocator and
+append it to the end of the chunk list as a single free chunk.
+Try for a generous region first, then fall back to the minimum
+needed to satisfy this request.  Returns the new chunk, or null.
+*/
+
+static struct kmalloc_chunk *kgrow(struct kmalloc_chunk *tail, int length)
+{
+	struct kmalloc_chunk *c;
+	int npages = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+
+	c = page_alloc_contiguous(MAX(npages, KMALLOC_GROW_PAGES), 0, MEMORY_TAG_KMALLOC);
+	if(c) {
+		npages = MAX(npages, KMALLOC_GROW_PAGES);
+	} else {
+		c = page_alloc_contiguous(npages, 0, MEMORY_TAG_KMALLOC);
+		if(!c)
+			return 0;
+	}
+
+	c->state = KMALLOC_STATE_FREE;
+	c->length = npages * PAGE_SIZE;
+	c->next = 0;
+	c->prev = tail;
+
+	if(tail) {
+		tail->next = c;
+	} else {
+		head = c;
+	}
+
+	return c;
+}
+
+/*
+Large allocations are given their own run of pages,
+with a chunk header at the front recording the total length,
+so that kfree can hand the whole run back to the page allocator.
+*/
+
+static void *kmalloc_pages(int length, memory_tag_t tag, void *site)
+{
+	int npages = (length + PAGE_SIZE - 1) / PAGE_SIZE;
+
+	struct kmalloc_chunk *c = page_alloc_contiguous(npages, 0, MEMORY_TAG_KMALLOC);
+	if(!c) {
+		printf("kmalloc: out of memory!\n");
+		return 0;
+	}
+
+	c->state = KMALLOC_STATE_PAGES;
+	c->tag = tag;
+	c->length = npages * PAGE_SIZE;
+	c->next = 0;
+	c->prev = 0;
+
+	kcharge(c, c->length, site);
+
+	return (c + 1);
+}
+
 /*
 Allocate a chunk of memory of the given length.
 To avoid fragmentation, round up the length to
 a multiple of the chunk size.  Then, search fo
 a chunk of the desired size, and split it if necessary.
+If no chunk is large enough, grow the heap from the page allocator.
 */
 
+static void *kmalloc_internal(int length, memory_tag_t tag, void *site);
+
 void *kmalloc(int length)
+{
+	return kmalloc_internal(length, MEMORY_TAG_OTHER, __builtin_return_address(0));
+}
+
+/*
+Same as kmalloc, but charge the memory to the given subsystem.
+*/
+
+void *kmalloc_tag(int length, memory_tag_t tag)
+{
+	return kmalloc_internal(length, tag, __builtin_return_address(0));
+}
+
+static void *kmalloc_internal(int length, memory_tag_t tag, void *site)
 {
 	// round up length to a multiple of KUNIT
 	int extra = length % KUNIT;
@@ -76,15 +202,24 @@ void *kmalloc(int length)
 	// then add one more unit to accommodate the chunk header
 	length += KUNIT;
 
+	if(length > KMALLOC_LARGE)
+		return kmalloc_pages(length, tag, site);
+
 	struct kmalloc_chunk *c = head;
+	struct kmalloc_chunk *tail = 0;
 
 	while(1) {
 		if(!c) {
-			printf("kmalloc: out of memory!\n");
-			return 0;
+			c = kgrow(tail, length);
+			if(!c) {
+				printf("kmalloc: out of memory!\n");
+				return 0;
+			}
+			break;
 		}
 		if(c->state == KMALLOC_STATE_FREE && c->length >= length)
 			break;
+		tail = c;
 		c = c->next;
 	}
 
@@ -94,6 +229,8 @@ void *kmalloc(int length)
 	}
 
 	c->state = KMALLOC_STATE_USED;
+	c->tag = tag;
+	kcharge(c, c->length, site);
 
 	// return a pointer to the memory following the chunk header
 	return (c + 1);
@@ -102,6 +239,8 @@ void *kmalloc(int length)
 /*
 Attempt to merge a chunk with its successor,
 if it exists and both are in the free state.
+Chunks from separately grown regions may be neighbors
+in the list without being adjacent in memory, so check that too.
 */
 
 static void kmerge(struct kmalloc_chunk *c)
@@ -112,7 +251,7 @@ static void kmerge(struct kmalloc_chunk *c)
 	if(c->state != KMALLOC_STATE_FREE)
 		return;
 
-	if(c->next && c->next->state == KMALLOC_STATE_FREE) {
+	if(c->next && c->next->state == KMALLOC_STATE_FREE && (char *) c + c->length == (char *) c->next) {
 		c->length += c->next->length;
 		if(c->next->next) {
 			c->next->next->prev = c;
@@ -132,11 +271,19 @@ void kfree(void *ptr)
 	struct kmalloc_chunk *c = (struct kmalloc_chunk *) ptr;
 	c--;
 
+	if(c->state == KMALLOC_STATE_PAGES) {
+		kcharge(c, -c->length, __builtin_return_address(0));
+		c->state = 0;
+		page_free_contiguous(c, c->length / PAGE_SIZE);
+		return;
+	}
+
 	if(c->state != KMALLOC_STATE_USED) {
 		printf("invalid kfree(%x)\n", ptr);
 		return;
 	}
 
+	kcharge(c, -c->length, __builtin_return_address(0));
 	c->state = KMALLOC_STATE_FREE;
 
 	kmerge(c);
@@ -200,10 +347,30 @@ static int kmalloc_test_single_alloc_and_free(void)
 	return res;
 }
 
+static int kmalloc_test_large_alloc_and_free(void)
+{
+	uint32_t before, after, total;
+	page_stats(&before, &total);
+
+	char *ptr = kmalloc(3 * PAGE_SIZE);
+	struct kmalloc_chunk *c = (struct kmalloc_chunk *) ptr - 1;
+	int res = ptr != 0;
+	res &= c->state == KMALLOC_STATE_PAGES;
+	res &= c->length == 4 * PAGE_SIZE;
+	res &= head->state == KMALLOC_STATE_FREE;
+	res &= head->next == 0;
+
+	kfree(ptr);
+	page_stats(&after, &total);
+	res &= before == after;
+
+	return res;
+}
+
 int kmalloc_test(void)
 {
 	int (*tests[]) (void) = {
-	kmalloc_test_single_alloc, kmalloc_test_single_alloc_and_free,};
+	kmalloc_test_single_alloc, kmalloc_test_single_alloc_and_free, kmalloc_test_large_alloc_and_free,};
 
 	int i = 0;
 	for(i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
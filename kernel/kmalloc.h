@@ -7,11 +7,15 @@ See the file LICENSE for details.
 #ifndef KMALLOC_H
 #define KMALLOC_H
 
+#include "kernel/stats.h"
+
 void *kmalloc(int length);
+void *kmalloc_tag(int length, memory_tag_t tag);
 void kfree(void *ptr);
 
 void kmalloc_init(char *start, int length);
 void kmalloc_debug();
+void kmalloc_stats(struct memory_stats *s);
 int kmalloc_test();
 
 #endif
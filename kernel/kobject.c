@@ -14,6 +14,9 @@
 #include "window.h"
 #include "console.h"
 #include "pipe.h"
+#include "shmem.h"
+#include "poll.h"
+#include "page.h"
 
 #include "kernel/error.h"
 
@@ -75,6 +78,14 @@ struct kobject *kobject_create_pipe(struct pipe *p)
 	return k;
 }
 
+struct kobject *kobject_create_shmem(struct shmem *s)
+{
+	struct kobject *k = kobject_create();
+	k->type = KOBJECT_SHMEM;
+	k->data.shmem = s;
+	return k;
+}
+
 struct kobject *kobject_addref(struct kobject *k)
 {
 	k->refcount++;
@@ -115,6 +126,9 @@ struct kobject * kobject_copy( struct kobject *ksrc )
 	case KOBJECT_PIPE:
 		pipe_addref(ksrc->data.pipe);
 		break;
+	case KOBJECT_SHMEM:
+		shmem_addref(ksrc->data.shmem);
+		break;
 	}
 
 	return kdst;
@@ -259,6 +273,60 @@ int kobject_write(struct kobject *kobject, void *buffer, int size, kernel_io_fla
 	return 0;
 }
 
+/*
+Move up to length bytes from one object to another entirely within
+the kernel, a page at a time, so that the data never passes through
+user memory.  Stop at the end of the source, which for a pipe means
+a read that finds it empty and flushed, or when the destination
+takes less than offered, in which case a file source is wound back
+so that nothing is lost.  Only a file is known to be at its end
+after a short read; other sources may simply have had less ready.
+Return the number of bytes moved, or an error if none were.
+*/
+
+int kobject_transfer(struct kobject *src, struct kobject *dst, int length)
+{
+	int total = 0;
+	int chunk, n, m;
+	memory_tag_t tag;
+
+	switch(src->type) {
+	case KOBJECT_PIPE:
+		tag = MEMORY_TAG_PIPE;
+		break;
+	case KOBJECT_FILE:
+		tag = MEMORY_TAG_FS;
+		break;
+	default:
+		tag = MEMORY_TAG_OTHER;
+		break;
+	}
+
+	/* Unlike page_alloc, this returns zero rather than halting when memory runs out. */
+	char *buffer = page_alloc_contiguous(1, 0, tag);
+	if(!buffer) return KERROR_OUT_OF_MEMORY;
+
+	while(total < length) {
+		chunk = MIN(length - total, PAGE_SIZE);
+		n = kobject_read(src, buffer, chunk, 0);
+		if(n <= 0) {
+			if(n < 0 && total == 0) total = n;
+			break;
+		}
+		m = kobject_write(dst, buffer, n, 0);
+		if(m > 0) total += m;
+		if(m < n) {
+			if(src->type == KOBJECT_FILE) src->offset -= n - MAX(m, 0);
+			if(m < 0 && total == 0) total = m;
+			break;
+		}
+		if(n < chunk && src->type == KOBJECT_FILE) break;
+	}
+
+	page_free_contiguous(buffer, 1);
+	return total;
+}
+
 int kobject_list(struct kobject *kobject, void *buffer, int size)
 {
 	if(kobject->type==KOBJECT_DIR) {
@@ -323,6 +391,9 @@ int kobject_close(struct kobject *kobject)
 		case KOBJECT_PIPE:
 			pipe_delete(kobject->data.pipe);
 			break;
+		case KOBJECT_SHMEM:
+			shmem_delete(kobject->data.shmem);
+			break;
 		default:
 			break;
 		}
@@ -338,6 +409,50 @@ int kobject_close(struct kobject *kobject)
 	return 0;
 }
 
+/*
+Drop a reference taken with kobject_addref.  Unlike kobject_close,
+this does not flush a pipe, since no descriptor is going away.
+*/
+
+void kobject_release(struct kobject *kobject)
+{
+	if(kobject->refcount > 1) {
+		kobject->refcount--;
+	} else {
+		kobject_close(kobject);
+	}
+}
+
+/*
+Return which of the requested events (KERNEL_POLL_READ, KERNEL_POLL_WRITE)
+are ready on the object.  If w is given, it is hung on the object so
+that a later change wakes the poller.  Files, directories, and devices
+never wait for long, so they are always ready.
+*/
+
+int kobject_poll(struct kobject *kobject, int events, struct poll_waiter *w)
+{
+	int ready = KERNEL_POLL_WRITE;
+
+	switch (kobject->type) {
+	case KOBJECT_PIPE:
+		return pipe_poll(kobject->data.pipe, events, w);
+	case KOBJECT_WINDOW:
+		if(window_poll(kobject->data.window, 0, w))
+			ready |= KERNEL_POLL_READ;
+		break;
+	case KOBJECT_CONSOLE:
+		if(console_poll(kobject->data.console, w))
+			ready |= KERNEL_POLL_READ;
+		break;
+	default:
+		ready |= KERNEL_POLL_READ;
+		break;
+	}
+
+	return ready & events;
+}
+
 int kobject_size(struct kobject *kobject, int *dims, int n)
 {
 	switch (kobject->type) {
@@ -385,10 +500,56 @@ int kobject_size(struct kobject *kobject, int *dims, int n)
 		} else {
 			return KERROR_INVALID_REQUEST;
 		}
+	case KOBJECT_SHMEM:
+		if(n==1) {
+			dims[0] = shmem_size(kobject->data.shmem);
+			return 0;
+		} else {
+			return KERROR_INVALID_REQUEST;
+		}
 	}
 	return KERROR_INVALID_REQUEST;
 }
 
+int kobject_resize(struct kobject *kobject, int size)
+{
+	switch (kobject->type) {
+	case KOBJECT_PIPE:
+		return pipe_resize(kobject->data.pipe, size);
+	default:
+		return KERROR_NOT_IMPLEMENTED;
+	}
+}
+
+/*
+Objects backed by memory (only shared memory, for now) are mapped
+into the address space of every process that holds them.
+kobject_map returns zero on success, and is a no-op for other types.
+*/
+
+int kobject_map(struct kobject *kobject, struct pagetable *p)
+{
+	if(kobject->type==KOBJECT_SHMEM) {
+		if(!shmem_map(kobject->data.shmem, p)) return KERROR_OUT_OF_MEMORY;
+	}
+	return 0;
+}
+
+void kobject_unmap(struct kobject *kobject, struct pagetable *p)
+{
+	if(kobject->type==KOBJECT_SHMEM) {
+		shmem_unmap(kobject->data.shmem, p);
+	}
+}
+
+uint32_t kobject_address(struct kobject *kobject)
+{
+	if(kobject->type==KOBJECT_SHMEM) {
+		return shmem_address(kobject->data.shmem);
+	}
+	return 0;
+}
+
 int kobject_get_type(struct kobject *kobject)
 {
 	return kobject->type;
@@ -14,6 +14,7 @@
 #include "window.h"
 #include "console.h"
 #include "pipe.h"
+#include "shmem.h"
 #include "event.h"
 
 struct kobject {
@@ -24,6 +25,7 @@ struct kobject {
 		struct window *window;
 		struct console *console;
 		struct pipe *pipe;
+		struct shmem *shmem;
 	} data;
 	kobject_type_t type;
 	int refcount;
@@ -37,6 +39,7 @@ struct kobject *kobject_create_device(struct device *d);
 struct kobject *kobject_create_window(struct window *g);
 struct kobject *kobject_create_console(struct console *c);
 struct kobject *kobject_create_pipe(struct pipe *p);
+struct kobject *kobject_create_shmem(struct shmem *s);
 struct kobject *kobject_create_event();
 
 struct kobject *kobject_create_window_from_window( struct kobject *k, int x, int y, int w, int h );
@@ -51,10 +54,20 @@ struct kobject * kobject_copy( struct kobject *ksrc );
 int kobject_read(struct kobject *kobject, void *buffer, int size, kernel_io_flags_t flags );
 int kobject_lookup( struct kobject *kobject, const char *name, struct kobject **newobj );
 int kobject_write(struct kobject *kobject, void *buffer, int size, kernel_io_flags_t flags );
+int kobject_transfer(struct kobject *src, struct kobject *dst, int length);
 int kobject_list( struct kobject *kobject, void *buffer, int size );
 int kobject_size(struct kobject *kobject, int *dimensions, int n);
+int kobject_resize(struct kobject *kobject, int size);
 int kobject_remove( struct kobject *kobject, const char *name );
 int kobject_close(struct kobject *kobject);
+void kobject_release(struct kobject *kobject);
+
+struct poll_waiter;
+int kobject_poll(struct kobject *kobject, int events, struct poll_waiter *w);
+
+int kobject_map(struct kobject *kobject, struct pagetable *p);
+void kobject_unmap(struct kobject *kobject, struct pagetable *p);
+uint32_t kobject_address(struct kobject *kobject);
 
 int kobject_get_type(struct kobject *kobject);
 int kobject_set_tag(struct kobject *kobject, char *new_tag);
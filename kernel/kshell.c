@@ -24,6 +24,7 @@ for the NexShell kernel
 #include "clock.h"
 #include "kernelcore.h"
 #include "bcache.h"
+#include "workqueue.h"
 #include "printf.h"
 #include "graphics.h" // Include your graphics header
 
@@ -38,7 +39,7 @@ for the NexShell kernel
 
 static int kshell_mount( const char *devname, int unit, const char *fs_type)
 {
-	if(current->ktable[KNO_STDDIR]) {
+	if(current->space->ktable[KNO_STDDIR]) {
 		printf("root filesystem already mounted, please unmount first\n");
 		return -1;
 	}
@@ -51,7 +52,7 @@ static int kshell_mount( const char *devname, int unit, const char *fs_type)
 			if(v) {
 				struct fs_dirent *d = fs_volume_root(v);
 				if(d) {
-					current->ktable[KNO_STDDIR] = kobject_create_dir(d);
+					process_object_set(current, KNO_STDDIR, kobject_create_dir(d));
 					return 0;
 				} else {
 					printf("mount: couldn't find root dir on %s unit %d!\n",device_name(dev),device_unit(dev));
@@ -109,6 +110,103 @@ static int kshell_listdir(const char *path)
 	return 0;
 }
 
+/*
+Exercise the system workqueue with many items at once, half of
+them allocated by the queue and half owned by us, and every other
+one yielding partway through so that workers interleave.
+*/
+
+#define WORKTEST_WORKERS 8
+
+struct worktest {
+	int count;
+	uint32_t sum;
+	uint32_t pids[WORKTEST_WORKERS];
+};
+
+struct worktest_item {
+	struct work work;
+	struct worktest *test;
+	int value;
+};
+
+static void kshell_worktest_item(void *arg)
+{
+	struct worktest_item *item = arg;
+	struct worktest *t = item->test;
+	int i;
+
+	if(item->value % 2)
+		process_yield();
+
+	t->count++;
+	t->sum += item->value;
+
+	for(i = 0; i < WORKTEST_WORKERS; i++) {
+		if(t->pids[i] == current->pid)
+			break;
+		if(!t->pids[i]) {
+			t->pids[i] = current->pid;
+			break;
+		}
+	}
+}
+
+static int kshell_worktest(int count)
+{
+	struct worktest t;
+	struct worktest_item *items;
+	uint64_t start, elapsed;
+	uint32_t expect;
+	int i, workers;
+
+	if(!workqueue_system) {
+		printf("worktest: no system workqueue\n");
+		return -1;
+	}
+
+	items = kmalloc(sizeof(*items) * count);
+	if(!items) {
+		printf("worktest: out of memory\n");
+		return -1;
+	}
+
+	memset(&t, 0, sizeof(t));
+
+	start = clock_nanos();
+	for(i = 0; i < count; i++) {
+		items[i].test = &t;
+		items[i].value = i;
+		if(i % 2) {
+			work_init(&items[i].work, kshell_worktest_item, &items[i]);
+			workqueue_submit_work(workqueue_system, &items[i].work);
+		} else if(workqueue_submit(workqueue_system, kshell_worktest_item, &items[i]) < 0) {
+			printf("worktest: couldn't submit item %d\n", i);
+			workqueue_flush(workqueue_system);
+			kfree(items);
+			return -1;
+		}
+	}
+	workqueue_flush(workqueue_system);
+	elapsed = clock_nanos() - start;
+
+	kfree(items);
+
+	for(workers = 0; workers < WORKTEST_WORKERS && t.pids[workers]; workers++) {
+	}
+
+	expect = (uint32_t) count * (count - 1) / 2;
+	printf("worktest: %d items on %d workers in %d us\n", t.count, workers, clock_divide(elapsed, 1000, 0));
+
+	if(t.count != count || t.sum != expect) {
+		printf("worktest: FAILED: expected %d items summing to %u, got %d summing to %u\n", count, expect, t.count, t.sum);
+		return -1;
+	}
+
+	printf("worktest: passed\n");
+	return 0;
+}
+
 static int kshell_execute(int argc, const char **argv)
 {
     if (argc < 1) {
@@ -193,6 +291,11 @@ void print_command_help(const char *command) {
         printf("Example: cowsay Hello!\n");
         printf("Shows a cow saying 'Hello!'. Just for laughs.\n\n");
 
+    } else if (!strcmp(command, "worktest")) {
+        printf("worktest [items]\n");
+        printf("Runs many small jobs at once on the kernel's worker threads and checks\n");
+        printf("that every one of them ran exactly once. The default is 1000 jobs.\n\n");
+
     } else if (!strcmp(command, "help")) {
         printf("help [command]\n");
         printf("If used by itself (just 'help'), it shows a list of all available commands.\n");
@@ -334,12 +437,19 @@ void print_command_help(const char *command) {
     } else if (!strcmp(cmd, "automount")) {
         automount();
 } else if (!strcmp(cmd, "unmount")) {
-if (current->ktable[KNO_STDDIR]) {
+if (current->space->ktable[KNO_STDDIR]) {
         printf("\nunmounting root directory\n");
         sys_object_close(KNO_STDDIR);
     } else {
         printf("\nnothing currently mounted\n");
     }
+} else if (!strcmp(cmd, "worktest")) {
+    int count = 1000;
+    if (argc > 1 && (!str2int(argv[1], &count) || count < 1)) {
+        printf("Usage: worktest [items]\n");
+    } else {
+        kshell_worktest(count);
+    }
 } else if (!strcmp(cmd, "cowsay")) {
     if (argc > 1) {
         // Calculate total length for the message
@@ -422,7 +532,8 @@ if (current->ktable[KNO_STDDIR]) {
         printf("automount\n");
         printf("unmount\n");
         printf("help <command>\n");
-        printf("contents <file>");
+        printf("contents <file>\n");
+        printf("worktest [items]\n");
         printf("cowsay\n\n");
 } else if (argc == 2) {
             print_command_help(argv[1]);
@@ -528,7 +639,7 @@ void shutdown_user() {
     }
 
    // unmount the disk and root file system
-if (current->ktable[KNO_STDDIR]) {
+if (current->space->ktable[KNO_STDDIR]) {
         sys_object_close(KNO_STDDIR);
     } else {
     }
@@ -23,9 +23,13 @@ See the file LICENSE for details.
 #include "kmalloc.h"
 #include "memorylayout.h"
 #include "kshell.h"
+#include "workqueue.h"
 #include "cdromfs.h"
 #include "diskfs.h"
 #include "serial.h"
+#include "cpu.h"
+#include "spinlock.h"
+#include "systrace.h"
 
 /*
 This is the C initialization point of the kernel.
@@ -36,6 +40,8 @@ Now we initialize each subsystem in the proper order:
 
 int kernel_main()
 {
+	kernel_lock_acquire();
+
 	struct console *console = console_create_root();
 	console_addref(console);
 
@@ -49,18 +55,23 @@ int kernel_main()
 	keyboard_init();
 	rtc_init();
 	clock_init();
+	cpu_init();
 	process_init();
 	ata_init();
 	cdrom_init();
 	diskfs_init();
+	systrace_init();
 
-	current->ktable[KNO_STDIN]   = kobject_create_console(console);
-	current->ktable[KNO_STDOUT]  = kobject_copy(current->ktable[0]);
-	current->ktable[KNO_STDERR]  = kobject_copy(current->ktable[1]);
-	current->ktable[KNO_STDWIN]  = kobject_create_window(&window_root);
-	current->ktable[KNO_STDDIR]  = 0; // No current dir until something is mounted.
+	process_object_set(current, KNO_STDIN, kobject_create_console(console));
+	process_object_set(current, KNO_STDOUT, kobject_copy(current->space->ktable[0]));
+	process_object_set(current, KNO_STDERR, kobject_copy(current->space->ktable[1]));
+	process_object_set(current, KNO_STDWIN, kobject_create_window(&window_root));
+	process_object_set(current, KNO_STDDIR, 0); // No current dir until something is mounted.
 
 	
+	cpu_start_all();
+	workqueue_init();
+
 	printf("\n");
 	kshell_launch();
 
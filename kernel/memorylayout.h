@@ -35,6 +35,16 @@ and by the kernel when no process is active.
 #define INTERRUPT_STACK_SEGMENT 0x0000
 #define INTERRUPT_STACK_OFFSET  0xfff0
 
+/*
+Secondary CPUs begin executing in real mode at CPU_TRAMPOLINE,
+a page of free memory below the bootblock, where the startup
+code is copied before they are woken.  The GDT has a TSS slot
+for each of up to CPU_MAX processors.
+*/
+
+#define CPU_TRAMPOLINE 0x1000
+#define CPU_MAX        8
+
 /*
 We choose the kernel code to start at 0x10000 (64KB).
 Code is loaded into this location by the bootblock.
@@ -56,6 +66,9 @@ The bootblock uses this to decide how much to load from disk.
 Following the kernel code is a direct mapper memory area
 set aside for kmalloc() which implements a list of small
 memory allocations for internal kernel purposes.
+This is only the initial heap: when it is exhausted, kmalloc
+grows by taking pages from main memory, and large allocations
+are served directly as runs of pages.
 */
 
 #define KMALLOC_START  0x100000
@@ -78,3 +91,21 @@ grow down.  Addresses below 0x80000000 are all supervisor mode.
 
 #define PROCESS_ENTRY_POINT 0x80000000
 #define PROCESS_STACK_INIT  0xfffffff0
+
+/*
+The heap grows up from the end of the program image and
+the stack grows down from the top, each on demand as pages
+are touched.  The stack may not grow below PROCESS_STACK_LIMIT,
+and the heap may not grow above PROCESS_DATA_LIMIT.
+Shared memory segments are placed in between, at the same
+address in every process that holds them.  The read-only
+time page (see include/kernel/timepage.h) sits just below
+the stack limit.
+*/
+
+#define PROCESS_STACK_LIMIT 0xf0000000
+#define PROCESS_DATA_LIMIT  0xc0000000
+#define PROCESS_TIME_PAGE   0xeffff000
+
+#define PROCESS_SHMEM_START PROCESS_DATA_LIMIT
+#define PROCESS_SHMEM_END   PROCESS_TIME_PAGE
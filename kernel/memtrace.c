@@ -0,0 +1,70 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+/*
+An optional ring of recent allocations and frees, recording
+the calling address of each, for tracking down leaks.
+Tracing is off by default, and the oldest entries are
+overwritten once the ring is full.
+*/
+
+#include "memtrace.h"
+
+#define MEMTRACE_SIZE 256
+
+static struct memory_trace ring[MEMTRACE_SIZE];
+static int ring_head = 0;
+static int ring_count = 0;
+static int enabled = 0;
+
+void memtrace_enable(int e)
+{
+	enabled = e;
+	if(!enabled) {
+		ring_head = 0;
+		ring_count = 0;
+	}
+}
+
+/*
+Length is positive for an allocation and negative for a free.
+*/
+
+void memtrace_record(int source, memory_tag_t tag, void *site, void *addr, int length)
+{
+	if(!enabled)
+		return;
+
+	struct memory_trace *t = &ring[ring_head];
+	t->site = (uint32_t) site;
+	t->addr = (uint32_t) addr;
+	t->length = length;
+	t->tag = tag;
+	t->source = source;
+
+	ring_head = (ring_head + 1) % MEMTRACE_SIZE;
+	if(ring_count < MEMTRACE_SIZE)
+		ring_count++;
+}
+
+/*
+Remove up to n of the oldest entries from the ring,
+and return the number copied out.
+*/
+
+int memtrace_read(struct memory_trace *t, int n)
+{
+	int i;
+	int first = (ring_head - ring_count + MEMTRACE_SIZE) % MEMTRACE_SIZE;
+
+	n = MIN(n, ring_count);
+	for(i = 0; i < n; i++) {
+		t[i] = ring[(first + i) % MEMTRACE_SIZE];
+	}
+	ring_count -= n;
+
+	return n;
+}
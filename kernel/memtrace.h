@@ -0,0 +1,17 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#ifndef MEMTRACE_H
+#define MEMTRACE_H
+
+#include "kernel/types.h"
+#include "kernel/stats.h"
+
+void memtrace_enable(int enabled);
+void memtrace_record(int source, memory_tag_t tag, void *site, void *addr, int length);
+int  memtrace_read(struct memory_trace *t, int n);
+
+#endif
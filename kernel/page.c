@@ -10,6 +10,7 @@ See the file LICENSE for details.
 #include "string.h"
 #include "memorylayout.h"
 #include "kernelcore.h"
+#include "memtrace.h"
 
 static uint32_t pages_free = 0;
 static uint32_t pages_total = 0;
@@ -20,6 +21,16 @@ static uint32_t freemap_bytes = 0;
 static uint32_t freemap_cells = 0;
 static uint32_t freemap_pages = 0;
 
+/*
+Alongside the free bitmap, keep one byte per page recording the
+subsystem that owns it, so that page_free can credit the right
+counter without the caller having to say.
+*/
+
+static uint8_t *page_tags = 0;
+static uint32_t pages_tagged[MEMORY_TAG_MAX];
+static uint32_t pages_tagged_peak[MEMORY_TAG_MAX];
+
 static void *main_memory_start = (void *) MAIN_MEMORY_START;
 
 #define CELL_BITS (8*sizeof(*freemap))
@@ -36,11 +47,13 @@ void page_init()
 	freemap_bits = pages_total;
 	freemap_bytes = 1 + freemap_bits / 8;
 	freemap_cells = 1 + freemap_bits / CELL_BITS;
-	freemap_pages = 1 + freemap_bytes / PAGE_SIZE;
+	freemap_pages = 1 + (freemap_bytes + pages_total) / PAGE_SIZE;
+	page_tags = (uint8_t *) freemap + freemap_bytes;
 
 	printf("memory: %d bits %d bytes %d cells %d pages\n", freemap_bits, freemap_bytes, freemap_cells, freemap_pages);
 
 	memset(freemap, 0xff, freemap_bytes);
+	memset(page_tags, MEMORY_TAG_OTHER, pages_total);
 	for(i = 0; i < freemap_pages; i++)
 		page_alloc(0);
 
@@ -59,7 +72,41 @@ void page_stats( uint32_t *nfree, uint32_t *ntotal )
 	*ntotal = pages_total;
 }
 
+void page_stats_tagged(struct memory_stats *s)
+{
+	int i;
+	s->pages_free = pages_free;
+	s->pages_total = pages_total;
+	for(i = 0; i < MEMORY_TAG_MAX; i++) {
+		s->pages[i] = pages_tagged[i];
+		s->pages_peak[i] = pages_tagged_peak[i];
+	}
+}
+
+static void page_charge(uint32_t pagenumber, uint32_t npages, memory_tag_t tag)
+{
+	uint32_t i;
+	for(i = 0; i < npages; i++) {
+		page_tags[pagenumber + i] = tag;
+	}
+	pages_tagged[tag] += npages;
+	if(pages_tagged[tag] > pages_tagged_peak[tag])
+		pages_tagged_peak[tag] = pages_tagged[tag];
+}
+
+static void *page_alloc_one(bool zeroit, memory_tag_t tag, void *site);
+
 void *page_alloc(bool zeroit)
+{
+	return page_alloc_one(zeroit, MEMORY_TAG_OTHER, __builtin_return_address(0));
+}
+
+void *page_alloc_tag(bool zeroit, memory_tag_t tag)
+{
+	return page_alloc_one(zeroit, tag, __builtin_return_address(0));
+}
+
+static void *page_alloc_one(bool zeroit, memory_tag_t tag, void *site)
 {
 	uint32_t i, j;
 	uint32_t cellmask;
@@ -82,6 +129,8 @@ void *page_alloc(bool zeroit)
 					if(zeroit)
 						memset(pageaddr, 0, PAGE_SIZE);
 					pages_free--;
+					page_charge(pagenumber, 1, tag);
+					memtrace_record(MEMORY_TRACE_PAGE, tag, site, pageaddr, PAGE_SIZE);
 					//printf("page: alloc %d\n",pages_free);
 					return pageaddr;
 				}
@@ -95,7 +144,86 @@ void *page_alloc(bool zeroit)
 	return 0;
 }
 
-void page_free(void *pageaddr)
+/*
+Allocate a run of physically contiguous pages, for callers
+(such as kmalloc) that need more than a single page at once.
+Unlike page_alloc, running out is not fatal: return zero and
+let the caller decide what to do.
+*/
+
+static void *page_alloc_run(uint32_t npages, uint32_t align, bool zeroit, memory_tag_t tag, void *site);
+
+void *page_alloc_contiguous(uint32_t npages, bool zeroit, memory_tag_t tag)
+{
+	return page_alloc_run(npages, 1, zeroit, tag, __builtin_return_address(0));
+}
+
+/*
+Same as above, but the physical address of the run must also
+be a multiple of align pages, as needed for a 4MB large page.
+*/
+
+void *page_alloc_aligned(uint32_t npages, uint32_t align, bool zeroit, memory_tag_t tag)
+{
+	return page_alloc_run(npages, align, zeroit, tag, __builtin_return_address(0));
+}
+
+static void *page_alloc_run(uint32_t npages, uint32_t align, bool zeroit, memory_tag_t tag, void *site)
+{
+	uint32_t i, start = 0, run = 0;
+	uint32_t first = (uint32_t) main_memory_start >> PAGE_BITS;
+	void *pageaddr;
+
+	if(!freemap) {
+		printf("memory: not initialized yet!\n");
+		return 0;
+	}
+
+	if(npages == 0 || npages > pages_free)
+		return 0;
+
+	for(i = 0; i < pages_total; i++) {
+		uint32_t cell = freemap[i / CELL_BITS];
+
+		// skip over fully allocated cells quickly
+		if(run == 0 && (i % CELL_BITS) == 0 && cell == 0) {
+			i += CELL_BITS - 1;
+			continue;
+		}
+
+		if(cell & (1 << (i % CELL_BITS))) {
+			if(run == 0) {
+				if((first + i) % align)
+					continue;
+				start = i;
+			}
+			run++;
+			if(run == npages)
+				break;
+		} else {
+			run = 0;
+		}
+	}
+
+	if(run < npages)
+		return 0;
+
+	for(i = start; i < start + npages; i++) {
+		freemap[i / CELL_BITS] &= ~(1 << (i % CELL_BITS));
+	}
+	pages_free -= npages;
+	page_charge(start, npages, tag);
+
+	pageaddr = (start << PAGE_BITS) + main_memory_start;
+	if(zeroit)
+		memset(pageaddr, 0, npages * PAGE_SIZE);
+
+	memtrace_record(MEMORY_TRACE_PAGE, tag, site, pageaddr, npages * PAGE_SIZE);
+
+	return pageaddr;
+}
+
+static void page_free_one(void *pageaddr)
 {
 	uint32_t pagenumber = (pageaddr - main_memory_start) >> PAGE_BITS;
 	uint32_t cellnumber = pagenumber / CELL_BITS;
@@ -103,5 +231,23 @@ void page_free(void *pageaddr)
 	uint32_t cellmask = (1 << celloffset);
 	freemap[cellnumber] |= cellmask;
 	pages_free++;
+	pages_tagged[page_tags[pagenumber]]--;
 	//printf("page: free %d\n",pages_free);
 }
+
+void page_free_contiguous(void *pageaddr, uint32_t npages)
+{
+	uint32_t i;
+	uint32_t pagenumber = (pageaddr - main_memory_start) >> PAGE_BITS;
+	memtrace_record(MEMORY_TRACE_PAGE, page_tags[pagenumber], __builtin_return_address(0), pageaddr, -(int) (npages * PAGE_SIZE));
+	for(i = 0; i < npages; i++) {
+		page_free_one(pageaddr + i * PAGE_SIZE);
+	}
+}
+
+void page_free(void *pageaddr)
+{
+	uint32_t pagenumber = (pageaddr - main_memory_start) >> PAGE_BITS;
+	memtrace_record(MEMORY_TRACE_PAGE, page_tags[pagenumber], __builtin_return_address(0), pageaddr, -PAGE_SIZE);
+	page_free_one(pageaddr);
+}
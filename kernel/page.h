@@ -8,10 +8,16 @@ See the file LICENSE for details.
 #define PAGE_H
 
 #include "kernel/types.h"
+#include "kernel/stats.h"
 
 void  page_init();
 void *page_alloc(bool zeroit);
+void *page_alloc_tag(bool zeroit, memory_tag_t tag);
 void  page_free(void *addr);
+void *page_alloc_contiguous(uint32_t npages, bool zeroit, memory_tag_t tag);
+void *page_alloc_aligned(uint32_t npages, uint32_t align, bool zeroit, memory_tag_t tag);
+void  page_free_contiguous(void *addr, uint32_t npages);
 void  page_stats( uint32_t *nfree, uint32_t *ntotal );
+void  page_stats_tagged(struct memory_stats *s);
 
 #endif
@@ -8,9 +8,30 @@ See the file LICENSE for details.
 #include "page.h"
 #include "string.h"
 #include "kernelcore.h"
+#include "apic.h"
+#include "cpu.h"
 
 #define ENTRIES_PER_TABLE (PAGE_SIZE/4)
 
+/*
+Invalidating pages one at a time with invlpg is cheaper than
+reloading cr3, but only up to a point.  Beyond this many pages,
+just flush the whole TLB once.
+*/
+
+#define PAGETABLE_INVLPG_MAX 32
+
+/*
+The bits available to software in each entry record whether
+the page belongs to this table, and so is freed with it, or
+is shared with others and must be copied before it is written.
+*/
+
+#define PAGE_AVAIL_ALLOC 1
+#define PAGE_AVAIL_COPY  2
+
+static int pagetable_large_supported = 0;
+
 struct pageentry {
 	unsigned present:1;	// 1 = present
 	unsigned readwrite:1;	// 1 = writable
@@ -34,7 +55,7 @@ struct pagetable {
 
 struct pagetable *pagetable_create()
 {
-	return page_alloc(1);
+	return page_alloc_tag(1, MEMORY_TAG_PAGETABLE);
 }
 
 void pagetable_init(struct pagetable *p)
@@ -48,6 +69,9 @@ void pagetable_init(struct pagetable *p)
 	for(i = (unsigned) video_buffer; i <= stop; i += PAGE_SIZE) {
 		pagetable_map(p, i, i, PAGE_FLAG_KERNEL | PAGE_FLAG_READWRITE);
 	}
+	if(apic_address()) {
+		pagetable_map(p, apic_address(), apic_address(), PAGE_FLAG_KERNEL | PAGE_FLAG_READWRITE | PAGE_FLAG_NOCACHE);
+	}
 }
 
 int pagetable_getmap(struct pagetable *p, unsigned vaddr, unsigned *paddr, int *flags)
@@ -62,20 +86,26 @@ int pagetable_getmap(struct pagetable *p, unsigned vaddr, unsigned *paddr, int *
 	if(!e->present)
 		return 0;
 
-	q = (struct pagetable *) (e->addr << 12);
+	if(e->pagesize) {
+		*paddr = (e->addr << 12) + (b << 12);
+	} else {
+		q = (struct pagetable *) (e->addr << 12);
 
-	e = &q->entry[b];
-	if(!e->present)
-		return 0;
+		e = &q->entry[b];
+		if(!e->present)
+			return 0;
 
-	*paddr = e->addr << 12;
+		*paddr = e->addr << 12;
+	}
 
 	if(flags) {
 		*flags = 0;
 		if(e->readwrite)
 			*flags |= PAGE_FLAG_READWRITE;
-		if(e->avail & 0x01)
+		if(e->avail & PAGE_AVAIL_ALLOC)
 			*flags |= PAGE_FLAG_ALLOC;
+		if(e->avail & PAGE_AVAIL_COPY)
+			*flags |= PAGE_FLAG_COPY;
 		if(!e->user)
 			*flags |= PAGE_FLAG_KERNEL;
 	}
@@ -83,21 +113,80 @@ int pagetable_getmap(struct pagetable *p, unsigned vaddr, unsigned *paddr, int *
 	return 1;
 }
 
-int pagetable_map(struct pagetable *p, unsigned vaddr, unsigned paddr, int flags)
+static void pagetable_entry_set(struct pageentry *e, unsigned paddr, int flags)
+{
+	e->present = 1;
+	e->readwrite = (flags & PAGE_FLAG_READWRITE) ? 1 : 0;
+	e->user = (flags & PAGE_FLAG_KERNEL) ? 0 : 1;
+	e->writethrough = (flags & PAGE_FLAG_NOCACHE) ? 1 : 0;
+	e->nocache = (flags & PAGE_FLAG_NOCACHE) ? 1 : 0;
+	e->accessed = 0;
+	e->dirty = 0;
+	e->pagesize = 0;
+	e->globalpage = !e->user;
+	e->avail = (flags & PAGE_FLAG_ALLOC) ? PAGE_AVAIL_ALLOC : 0;
+	if(flags & PAGE_FLAG_COPY)
+		e->avail |= PAGE_AVAIL_COPY;
+	e->addr = (paddr >> 12);
+}
+
+static int pagetable_is_active(struct pagetable *p)
 {
+	struct pagetable *active;
+      asm("mov %%cr3, %0":"=r"(active));
+	return active == p;
+}
+
+void pagetable_invalidate(unsigned vaddr)
+{
+	asm volatile ("invlpg (%0)"::"r"(vaddr):"memory");
+}
+
+/*
+Break a 4MB large page into an ordinary second level table
+that maps the same physical pages.  Because the page allocator
+tracks each page individually, pages that came from a large
+allocation can afterwards be freed one at a time.
+*/
+
+static struct pagetable *pagetable_split(struct pagetable *p, unsigned vaddr)
+{
+	struct pageentry *e = &p->entry[vaddr >> 22];
 	struct pagetable *q;
-	struct pageentry *e;
+	unsigned j;
 
-	unsigned a = vaddr >> 22;
-	unsigned b = (vaddr >> 12) & 0x3ff;
+	q = pagetable_create();
+	if(!q)
+		return 0;
 
-	if(flags & PAGE_FLAG_ALLOC) {
-		paddr = (unsigned) page_alloc(flags & PAGE_FLAG_CLEAR);
-		if(!paddr)
-			return 0;
+	for(j = 0; j < ENTRIES_PER_TABLE; j++) {
+		q->entry[j] = *e;
+		q->entry[j].pagesize = 0;
+		q->entry[j].accessed = 0;
+		q->entry[j].dirty = 0;
+		q->entry[j].addr = e->addr + j;
 	}
 
-	e = &p->entry[a];
+	e->readwrite = 1;
+	e->pagesize = 0;
+	e->avail = 0;
+	e->addr = (((unsigned) q) >> 12);
+
+	if(pagetable_is_active(p))
+		pagetable_refresh();
+
+	return q;
+}
+
+/*
+Return the second level table covering vaddr,
+creating it (or splitting a large page) if necessary.
+*/
+
+static struct pagetable *pagetable_table(struct pagetable *p, unsigned vaddr, int flags)
+{
+	struct pagetable *q;
+	struct pageentry *e = &p->entry[vaddr >> 22];
 
 	if(!e->present) {
 		q = pagetable_create();
@@ -114,24 +203,57 @@ int pagetable_map(struct pagetable *p, unsigned vaddr, unsigned paddr, int flags
 		e->globalpage = (flags & PAGE_FLAG_KERNEL) ? 1 : 0;
 		e->avail = 0;
 		e->addr = (((unsigned) q) >> 12);
+	} else if(e->pagesize) {
+		q = pagetable_split(p, vaddr);
 	} else {
 		q = (struct pagetable *) (((unsigned) e->addr) << 12);
 	}
 
+	return q;
+}
+
+/*
+Map a whole 4MB region at once with a single large page,
+backed by a 4MB aligned run of physical pages.
+Returns zero if large pages are unavailable or memory is too fragmented,
+in which case the caller should fall back to ordinary pages.
+*/
+
+static int pagetable_map_large(struct pagetable *p, unsigned vaddr, int flags)
+{
+	struct pageentry *e = &p->entry[vaddr >> 22];
+	void *paddr;
 
-	e = &q->entry[b];
+	if(!pagetable_large_supported || e->present)
+		return 0;
 
-	e->present = 1;
-	e->readwrite = (flags & PAGE_FLAG_READWRITE) ? 1 : 0;
-	e->user = (flags & PAGE_FLAG_KERNEL) ? 0 : 1;
-	e->writethrough = 0;
-	e->nocache = 0;
-	e->accessed = 0;
-	e->dirty = 0;
-	e->pagesize = 0;
-	e->globalpage = !e->user;
-	e->avail = (flags & PAGE_FLAG_ALLOC) ? 1 : 0;
-	e->addr = (paddr >> 12);
+	paddr = page_alloc_aligned(ENTRIES_PER_TABLE, ENTRIES_PER_TABLE, flags & PAGE_FLAG_CLEAR, MEMORY_TAG_USER);
+	if(!paddr)
+		return 0;
+
+	pagetable_entry_set(e, (unsigned) paddr, flags | PAGE_FLAG_ALLOC);
+	e->pagesize = 1;
+
+	return 1;
+}
+
+int pagetable_map(struct pagetable *p, unsigned vaddr, unsigned paddr, int flags)
+{
+	struct pagetable *q;
+
+	unsigned b = (vaddr >> 12) & 0x3ff;
+
+	if(flags & PAGE_FLAG_ALLOC) {
+		paddr = (unsigned) page_alloc_tag(flags & PAGE_FLAG_CLEAR, MEMORY_TAG_USER);
+		if(!paddr)
+			return 0;
+	}
+
+	q = pagetable_table(p, vaddr, flags);
+	if(!q)
+		return 0;
+
+	pagetable_entry_set(&q->entry[b], paddr, flags);
 
 	return 1;
 }
@@ -146,9 +268,18 @@ void pagetable_unmap(struct pagetable *p, unsigned vaddr)
 
 	e = &p->entry[a];
 	if(e->present) {
-		q = (struct pagetable *) (e->addr << 12);
+		if(e->pagesize) {
+			q = pagetable_split(p, vaddr);
+			if(!q)
+				return;
+		} else {
+			q = (struct pagetable *) (e->addr << 12);
+		}
 		e = &q->entry[b];
 		e->present = 0;
+		if(pagetable_is_active(p))
+			pagetable_invalidate(vaddr);
+		cpu_tlb_shootdown(p);
 	}
 }
 
@@ -161,11 +292,14 @@ void pagetable_delete(struct pagetable *p)
 
 	for(i = 0; i < ENTRIES_PER_TABLE; i++) {
 		e = &p->entry[i];
-		if(e->present) {
+		if(e->present && e->pagesize) {
+			if(e->avail & PAGE_AVAIL_ALLOC)
+				page_free_contiguous((void *) (e->addr << 12), ENTRIES_PER_TABLE);
+		} else if(e->present) {
 			q = (struct pagetable *) (e->addr << 12);
 			for(j = 0; j < ENTRIES_PER_TABLE; j++) {
 				e = &q->entry[j];
-				if(e->present && e->avail) {
+				if(e->present && (e->avail & PAGE_AVAIL_ALLOC)) {
 					void *paddr;
 					paddr = (void *) (e->addr << 12);
 					page_free(paddr);
@@ -178,8 +312,19 @@ void pagetable_delete(struct pagetable *p)
 	page_free(p);
 }
 
+/*
+Allocate and map fresh pages over a range of virtual memory,
+skipping any pages already present.  Walk one second level
+table at a time rather than looking up each page from the top.
+If PAGE_FLAG_LARGE is given, any aligned 4MB stretch that is
+entirely unmapped is covered by a single large page instead.
+Mapping previously absent pages requires no TLB invalidation.
+*/
+
 void pagetable_alloc(struct pagetable *p, unsigned vaddr, unsigned length, int flags)
 {
+	struct pagetable *q;
+	unsigned b;
 	unsigned npages = length / PAGE_SIZE;
 
 	if(length % PAGE_SIZE)
@@ -188,18 +333,46 @@ void pagetable_alloc(struct pagetable *p, unsigned vaddr, unsigned length, int f
 	vaddr &= 0xfffff000;
 
 	while(npages > 0) {
-		unsigned paddr;
-		if(!pagetable_getmap(p, vaddr, &paddr, 0)) {
-			pagetable_map(p, vaddr, 0, flags | PAGE_FLAG_ALLOC);
+		if((flags & PAGE_FLAG_LARGE) && !(vaddr & 0x3fffff) && npages >= ENTRIES_PER_TABLE) {
+			if(pagetable_map_large(p, vaddr, flags)) {
+				vaddr += ENTRIES_PER_TABLE * PAGE_SIZE;
+				npages -= ENTRIES_PER_TABLE;
+				continue;
+			}
+		}
+
+		q = pagetable_table(p, vaddr, flags);
+		if(!q)
+			return;
+
+		for(b = (vaddr >> 12) & 0x3ff; b < ENTRIES_PER_TABLE && npages > 0; b++) {
+			if(!q->entry[b].present) {
+				unsigned paddr = (unsigned) page_alloc_tag(flags & PAGE_FLAG_CLEAR, MEMORY_TAG_USER);
+				if(!paddr)
+					return;
+				pagetable_entry_set(&q->entry[b], paddr, flags | PAGE_FLAG_ALLOC);
+			}
+			vaddr += PAGE_SIZE;
+			npages--;
 		}
-		vaddr += PAGE_SIZE;
-		npages--;
 	}
 }
 
+/*
+Unmap a range of virtual memory, returning allocated pages
+to the page allocator.  If this is the active page table,
+invalidate just the affected TLB entries, or flush the whole
+TLB once if the range is large.
+*/
+
 void pagetable_free(struct pagetable *p, unsigned vaddr, unsigned length)
 {
+	struct pagetable *q;
+	struct pageentry *e;
+	unsigned b;
+	unsigned nfreed = 0;
 	unsigned npages = length / PAGE_SIZE;
+	int active = pagetable_is_active(p);
 
 	if(length % PAGE_SIZE)
 		npages++;
@@ -207,16 +380,95 @@ void pagetable_free(struct pagetable *p, unsigned vaddr, unsigned length)
 	vaddr &= 0xfffff000;
 
 	while(npages > 0) {
-		unsigned paddr;
-		int flags;
-		if(pagetable_getmap(p, vaddr, &paddr, &flags)) {
-			pagetable_unmap(p, vaddr);
-			if(flags & PAGE_FLAG_ALLOC)
-				page_free((void *) paddr);
+		e = &p->entry[vaddr >> 22];
+		b = (vaddr >> 12) & 0x3ff;
+
+		if(!e->present) {
+			unsigned skip = MIN(npages, ENTRIES_PER_TABLE - b);
+			vaddr += skip * PAGE_SIZE;
+			npages -= skip;
+			continue;
+		}
+
+		if(e->pagesize) {
+			if(b == 0 && npages >= ENTRIES_PER_TABLE) {
+				if(e->avail & PAGE_AVAIL_ALLOC)
+					page_free_contiguous((void *) (e->addr << 12), ENTRIES_PER_TABLE);
+				e->present = 0;
+				e->pagesize = 0;
+				if(active)
+					pagetable_invalidate(vaddr);
+				vaddr += ENTRIES_PER_TABLE * PAGE_SIZE;
+				npages -= ENTRIES_PER_TABLE;
+				nfreed++;
+				continue;
+			}
+			q = pagetable_split(p, vaddr);
+			if(!q)
+				return;
+		} else {
+			q = (struct pagetable *) (e->addr << 12);
+		}
+
+		for(; b < ENTRIES_PER_TABLE && npages > 0; b++) {
+			e = &q->entry[b];
+			if(e->present) {
+				e->present = 0;
+				if(e->avail & PAGE_AVAIL_ALLOC)
+					page_free((void *) (e->addr << 12));
+				if(active && nfreed < PAGETABLE_INVLPG_MAX)
+					pagetable_invalidate(vaddr);
+				nfreed++;
+			}
+			vaddr += PAGE_SIZE;
+			npages--;
+		}
+	}
+
+	if(active && nfreed >= PAGETABLE_INVLPG_MAX)
+		pagetable_refresh();
+	if(nfreed)
+		cpu_tlb_shootdown(p);
+}
+
+/*
+Count the allocated pages actually present in a range of
+virtual memory, for resident set accounting.
+*/
+
+unsigned pagetable_resident(struct pagetable *p, unsigned vaddr, unsigned length)
+{
+	struct pagetable *q;
+	struct pageentry *e;
+	unsigned b;
+	unsigned count = 0;
+	unsigned npages = length / PAGE_SIZE;
+
+	vaddr &= 0xfffff000;
+
+	while(npages > 0) {
+		e = &p->entry[vaddr >> 22];
+		b = (vaddr >> 12) & 0x3ff;
+
+		unsigned n = MIN(npages, ENTRIES_PER_TABLE - b);
+
+		if(e->present && e->pagesize) {
+			if(e->avail & PAGE_AVAIL_ALLOC)
+				count += n;
+		} else if(e->present) {
+			q = (struct pagetable *) (e->addr << 12);
+			unsigned j;
+			for(j = b; j < b + n; j++) {
+				if(q->entry[j].present && (q->entry[j].avail & PAGE_AVAIL_ALLOC))
+					count++;
+			}
 		}
-		vaddr += PAGE_SIZE;
-		npages--;
+
+		vaddr += n * PAGE_SIZE;
+		npages -= n;
 	}
+
+	return count;
 }
 
 struct pagetable *pagetable_load(struct pagetable *p)
@@ -227,6 +479,48 @@ struct pagetable *pagetable_load(struct pagetable *p)
 	return oldp;
 }
 
+/*
+Give p a private, writable copy of the shared page at vaddr,
+if it is marked copy-on-write.  Returns false if it is not,
+or if no page is available for the copy.  Returns true if the
+page is already writable, as another thread may have copied
+it first.
+*/
+
+int pagetable_copy_on_write(struct pagetable *p, unsigned vaddr)
+{
+	struct pagetable *q;
+	struct pageentry *e;
+	void *copy;
+
+	e = &p->entry[vaddr >> 22];
+	if(!e->present || e->pagesize)
+		return 0;
+
+	q = (struct pagetable *) (e->addr << 12);
+	e = &q->entry[(vaddr >> 12) & 0x3ff];
+	if(e->present && e->readwrite)
+		return 1;
+	if(!e->present || !(e->avail & PAGE_AVAIL_COPY))
+		return 0;
+
+	copy = page_alloc_tag(0, MEMORY_TAG_USER);
+	if(!copy)
+		return 0;
+
+	memcpy(copy, (void *) (e->addr << 12), PAGE_SIZE);
+	e->addr = ((unsigned) copy) >> 12;
+	e->readwrite = 1;
+	e->avail = PAGE_AVAIL_ALLOC;
+
+	/* Other threads must not go on seeing the shared page. */
+	if(pagetable_is_active(p))
+		pagetable_invalidate(vaddr);
+	cpu_tlb_shootdown(p);
+
+	return 1;
+}
+
 void pagetable_refresh()
 {
 	asm("mov %cr3, %eax");
@@ -235,8 +529,20 @@ void pagetable_refresh()
 
 void pagetable_enable()
 {
+	uint32_t eax, ebx, ecx, edx;
+
+	/* If the processor has the page size extension, allow 4MB pages. */
+	asm volatile ("cpuid":"=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx):"a"(1));
+	if(edx & (1 << 3)) {
+		asm("movl %cr4, %eax");
+		asm("orl $0x10, %eax");
+		asm("movl %eax, %cr4");
+		pagetable_large_supported = 1;
+	}
+
+	/* Write protect applies to the kernel too, so that copy-on-write pages fault on any write. */
 	asm("movl %cr0, %eax");
-	asm("orl $0x80000000, %eax");
+	asm("orl $0x80010000, %eax");
 	asm("movl %eax, %cr0");
 }
 
@@ -256,7 +562,17 @@ struct pagetable *pagetable_duplicate(struct pagetable *sp)
 	for(i = 0; i < ENTRIES_PER_TABLE; i++) {
 		e = &sp->entry[i];
 		newe = &newp->entry[i];
-		if(e->present) {
+		if(e->present && e->pagesize) {
+			void *new_paddr = (void *) (e->addr << 12);
+			if(e->avail & PAGE_AVAIL_ALLOC) {
+				new_paddr = page_alloc_aligned(ENTRIES_PER_TABLE, ENTRIES_PER_TABLE, 0, MEMORY_TAG_USER);
+				if(!new_paddr)
+					goto cleanup;
+				memcpy(new_paddr, (void *) (e->addr << 12), ENTRIES_PER_TABLE * PAGE_SIZE);
+			}
+			memcpy(newe, e, sizeof(struct pageentry));
+			newe->addr = (((unsigned) new_paddr) >> 12);
+		} else if(e->present) {
 			q = (struct pagetable *) (e->addr << 12);
 			newq = pagetable_create();
 			if(!newq)
@@ -271,8 +587,8 @@ struct pagetable *pagetable_duplicate(struct pagetable *sp)
 					void *paddr;
 					paddr = (void *) (e->addr << 12);
 					void *new_paddr = 0;
-					if(e->avail) {
-						new_paddr = page_alloc(0);
+					if(e->avail & PAGE_AVAIL_ALLOC) {
+						new_paddr = page_alloc_tag(0, MEMORY_TAG_USER);
 						if(!new_paddr)
 							goto cleanup;
 						memcpy(new_paddr, paddr, PAGE_SIZE);
@@ -17,6 +17,9 @@ See the file LICENSE for details.
 #define PAGE_FLAG_READWRITE   4
 #define PAGE_FLAG_NOCLEAR     0
 #define PAGE_FLAG_CLEAR       8
+#define PAGE_FLAG_LARGE       16
+#define PAGE_FLAG_NOCACHE     32
+#define PAGE_FLAG_COPY        64
 
 struct pagetable *pagetable_create();
 void pagetable_init(struct pagetable *p);
@@ -25,10 +28,13 @@ int pagetable_getmap(struct pagetable *p, unsigned vaddr, unsigned *paddr, int *
 void pagetable_unmap(struct pagetable *p, unsigned vaddr);
 void pagetable_alloc(struct pagetable *p, unsigned vaddr, unsigned length, int flags);
 void pagetable_free(struct pagetable *p, unsigned vaddr, unsigned length);
+unsigned pagetable_resident(struct pagetable *p, unsigned vaddr, unsigned length);
 void pagetable_delete(struct pagetable *p);
 struct pagetable *pagetable_duplicate(struct pagetable *p);
 struct pagetable *pagetable_load(struct pagetable *p);
 void pagetable_enable();
 void pagetable_refresh();
+void pagetable_invalidate(unsigned vaddr);
+int pagetable_copy_on_write(struct pagetable *p, unsigned vaddr);
 
 #endif
@@ -9,24 +9,69 @@ See the file LICENSE for details.
 #include "kmalloc.h"
 #include "process.h"
 #include "page.h"
+#include "spinlock.h"
+#include "poll.h"
+#include "pagetable.h"
+#include "string.h"
 
-#define PIPE_SIZE PAGE_SIZE
+/*
+The ring is one page unless asked otherwise at creation,
+and may be resized while in use, up to PIPE_MAX_PAGES.
+*/
+
+#define PIPE_DEFAULT_SIZE PAGE_SIZE
+
+/*
+A blocking write of at least PIPE_DIRECT_MIN bytes into an empty
+pipe, too large for the ring and so bound to block anyway, skips
+the ring.  The writer publishes where its data lies and sleeps
+on direct_queue, while readers copy straight out of the writer's
+pages.  A writer that is killed while asleep is removed from
+direct_queue, so readers trust the published pages only while
+direct_queue is non-empty.
+*/
+
+#define PIPE_DIRECT_MIN PAGE_SIZE
+
+struct pipe_direct {
+	struct pagetable *pagetable;
+	const char *addr;
+	int length;
+	int done;
+};
 
 struct pipe {
 	char *buffer;
+	int size;
 	int read_pos;
 	int write_pos;
 	int flushed;
 	int refcount;
-	struct list queue;
+	struct pipe_direct *direct;
+	int read_want;
+	int write_want;
+	struct list readers;
+	struct list writers;
+	struct list direct_queue;
+	struct list pollers;
+	struct spinlock lock;
 };
 
-struct pipe *pipe_create()
+static int pipe_pages(int size)
+{
+	return (size + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+struct pipe *pipe_create(int size)
 {
-	struct pipe *p = kmalloc(sizeof(*p));
+	if(size == 0) size = PIPE_DEFAULT_SIZE;
+	if(size < 0 || pipe_pages(size) > PIPE_MAX_PAGES) return 0;
+
+	struct pipe *p = kmalloc_tag(sizeof(*p), MEMORY_TAG_PIPE);
 	if(!p) return 0;
 	
-	p->buffer = page_alloc(1);
+	p->size = pipe_pages(size) * PAGE_SIZE;
+	p->buffer = page_alloc_contiguous(pipe_pages(size), 0, MEMORY_TAG_PIPE);
 	if(!p->buffer) {
 		kfree(p);
 		return 0;
@@ -34,65 +79,281 @@ struct pipe *pipe_create()
 	p->read_pos = 0;
 	p->write_pos = 0;
 	p->flushed = 0;
-	p->queue.head = 0;
-	p->queue.tail = 0;
+	p->direct = 0;
+	p->read_want = 0;
+	p->write_want = 0;
+	p->readers.head = 0;
+	p->readers.tail = 0;
+	p->writers.head = 0;
+	p->writers.tail = 0;
+	p->direct_queue.head = 0;
+	p->direct_queue.tail = 0;
+	p->pollers.head = 0;
+	p->pollers.tail = 0;
 	p->refcount = 1;
+	spinlock_init(&p->lock);
 	return p;
 }
 
 struct pipe *pipe_addref( struct pipe *p )
 {
+	spinlock_acquire(&p->lock);
 	p->refcount++;
+	spinlock_release(&p->lock);
 	return p;
 }
 
 void pipe_flush(struct pipe *p)
 {
 	if(p) {
+		spinlock_acquire(&p->lock);
 		p->flushed = 1;
+		process_wakeup_all(&p->readers);
+		process_wakeup_all(&p->writers);
+		process_wakeup_all(&p->direct_queue);
+		spinlock_release(&p->lock);
+		poll_notify(&p->pollers);
 	}
 }
 
 void pipe_delete(struct pipe *p)
 {
+	int refcount;
+
 	if(!p) return;
 
-	p->refcount--;
-	if(p->refcount==0) {
+	spinlock_acquire(&p->lock);
+	refcount = --p->refcount;
+	spinlock_release(&p->lock);
+
+	if(refcount==0) {
 		if(p->buffer) {
-			page_free(p->buffer);
+			page_free_contiguous(p->buffer, p->size / PAGE_SIZE);
 		}
 		kfree(p);
 	}
 }
 
+static int pipe_used(struct pipe *p)
+{
+	return (p->write_pos - p->read_pos + p->size) % p->size;
+}
+
+static int pipe_free(struct pipe *p)
+{
+	return p->size - 1 - pipe_used(p);
+}
+
+/*
+User memory is never touched with the pipe locked, since a bad
+pointer would kill the caller in the middle of the copy and leave
+the lock held for good.  So the lock is dropped around each copy
+into or out of the ring, and the position moves only once the
+copy is complete.  Every caller holds the kernel lock, which keeps
+other readers, writers, and resizes away from the ring meanwhile.
+*/
+
+/* Copy n bytes out of the ring, in at most two spans around the wrap. */
+
+static void pipe_copy_out(struct pipe *p, char *buffer, int n)
+{
+	int first = MIN(n, p->size - p->read_pos);
+
+	memcpy(buffer, p->buffer + p->read_pos, first);
+	memcpy(buffer + first, p->buffer, n - first);
+}
+
+static int pipe_put(struct pipe *p, const char *buffer, int size)
+{
+	int n = MIN(size, pipe_free(p));
+	int first = MIN(n, p->size - p->write_pos);
+
+	if(n == 0) return 0;
+
+	spinlock_release(&p->lock);
+	memcpy(p->buffer + p->write_pos, buffer, first);
+	memcpy(p->buffer, buffer + first, n - first);
+	spinlock_acquire(&p->lock);
+	p->write_pos = (p->write_pos + n) % p->size;
+
+	return n;
+}
+
+static int pipe_get(struct pipe *p, char *buffer, int size)
+{
+	int n = MIN(size, pipe_used(p));
+
+	if(n == 0) return 0;
+
+	spinlock_release(&p->lock);
+	pipe_copy_out(p, buffer, n);
+	spinlock_acquire(&p->lock);
+	p->read_pos = (p->read_pos + n) % p->size;
+
+	return n;
+}
+
+/*
+Copy from the pages of a sleeping direct writer, a page at a
+time through the kernel's mapping of physical memory, straight
+into the reader's buffer.  The pipe is unlocked for each copy,
+so that a bad pointer cannot leave it locked, and the kernel
+lock held by every caller keeps the writer asleep meanwhile.
+It is woken here once its data is all gone, or if a page has
+disappeared under it, in which case it sends the rest through
+the ring.
+*/
+
+static int pipe_get_direct(struct pipe *p, char *buffer, int size)
+{
+	struct pipe_direct *d = p->direct;
+	unsigned vaddr, paddr, offset;
+	int n, total = 0;
+
+	if(!d) return 0;
+
+	if(!p->direct_queue.head) {
+		p->direct = 0;
+		return 0;
+	}
+
+	while(total < size && d->done < d->length) {
+		vaddr = (unsigned) d->addr + d->done;
+		offset = vaddr % PAGE_SIZE;
+		if(!pagetable_getmap(d->pagetable, vaddr, &paddr, 0)) {
+			d->length = d->done;
+			break;
+		}
+		n = MIN(size - total, MIN(d->length - d->done, PAGE_SIZE - offset));
+		spinlock_release(&p->lock);
+		memcpy(buffer + total, (char *) paddr + offset, n);
+		spinlock_acquire(&p->lock);
+		d->done += n;
+		total += n;
+	}
+
+	if(d->done == d->length) {
+		p->direct = 0;
+		process_wakeup_all(&p->direct_queue);
+	}
+
+	return total;
+}
+
+/*
+Publish a direct write and sleep until readers have taken it all,
+or a flush or a missing page cuts it short.  Called and returns
+with the pipe locked.
+*/
+
+static int pipe_put_direct(struct pipe *p, const char *buffer, int size)
+{
+	struct pipe_direct d;
+
+	d.pagetable = current->pagetable;
+	d.addr = buffer;
+	d.length = size;
+	d.done = 0;
+
+	p->direct = &d;
+	process_wakeup_all(&p->readers);
+	poll_notify(&p->pollers);
+
+	while(p->direct == &d) {
+		if(p->flushed) {
+			p->direct = 0;
+			break;
+		}
+		process_wait_locked(&p->direct_queue, &p->lock);
+		spinlock_acquire(&p->lock);
+	}
+
+	return d.done;
+}
+
+/* Fault in every page of a direct write, since readers cannot. */
+
+static void pipe_touch(const char *buffer, int size)
+{
+	const volatile char *b = buffer;
+	int i;
+
+	for(i = 0; i < size; i += PAGE_SIZE) {
+		(void) b[i];
+	}
+	(void) b[size - 1];
+}
+
+/*
+Readers and writers sleep on separate queues, and each side wakes
+only the other, once per call unless it has to sleep first.
+A sleeper records how much it is waiting for, and is not woken
+until that much data (or space) is there, or half the ring if it
+wants more: the high watermark for readers and the low watermark
+for writers.  Otherwise a reader taking a byte at a time would
+wake a blocked writer for each one, and the two would trade
+places at every byte.  Since a blocking call does not return
+until it is complete, waking it any earlier gains nothing.
+*/
+
+static void pipe_sleep(struct pipe *p, struct list *q, int *want, int amount)
+{
+	if(!q->head || amount < *want) *want = amount;
+	process_wait_locked(q, &p->lock);
+	spinlock_acquire(&p->lock);
+}
+
+static void pipe_wake_readers(struct pipe *p)
+{
+	if(p->readers.head && pipe_used(p) >= MIN(p->read_want, p->size / 2))
+		process_wakeup_all(&p->readers);
+}
+
+static void pipe_wake_writers(struct pipe *p)
+{
+	if(p->writers.head && pipe_free(p) >= MIN(p->write_want, p->size / 2))
+		process_wakeup_all(&p->writers);
+}
+
 static int pipe_write_internal(struct pipe *p, char *buffer, int size, int blocking )
 {
+	int written = 0;
+	int moved = 0;
+	int direct = blocking && current && size >= PIPE_DIRECT_MIN;
+	int n;
+
 	if(!p || !buffer) {
 		return -1;
 	}
-	int written = 0;
-	if(blocking) {
-		for(written = 0; written < size; written++) {
-			while((p->write_pos + 1) % PIPE_SIZE == p->read_pos) {
-				if(p->flushed) {
-					p->flushed = 0;
-					return written;
-				}
-				process_wait(&p->queue);
-			}
-			p->buffer[p->write_pos] = buffer[written];
-			p->write_pos = (p->write_pos + 1) % PIPE_SIZE;
+
+	if(direct) pipe_touch(buffer, size);
+
+	spinlock_acquire(&p->lock);
+	while(written < size) {
+		if(direct && !p->direct && p->read_pos == p->write_pos && size - written > pipe_free(p)) {
+			n = pipe_put_direct(p, buffer + written, size - written);
+			if(written + n < size && !p->flushed) direct = 0;
+		} else {
+			n = pipe_put(p, buffer + written, size - written);
+			if(n > 0) moved = 1;
 		}
-		process_wakeup_all(&p->queue);
-	} else {
-		while(written < size && p->write_pos != (p->read_pos - 1) % PIPE_SIZE) {
-			p->buffer[p->write_pos] = buffer[written];
-			p->write_pos = (p->write_pos + 1) % PIPE_SIZE;
-			written++;
+		written += n;
+		if(written == size || !blocking) break;
+		if(n > 0) continue;
+		if(p->flushed) break;
+		if(moved) {
+			pipe_wake_readers(p);
+			poll_notify(&p->pollers);
+			moved = 0;
 		}
+		pipe_sleep(p, &p->writers, &p->write_want, size - written);
 	}
 	p->flushed = 0;
+	if(moved)
+		pipe_wake_readers(p);
+	spinlock_release(&p->lock);
+	if(moved)
+		poll_notify(&p->pollers);
 	return written;
 }
 
@@ -108,34 +369,41 @@ int pipe_write_nonblock(struct pipe *p, char *buffer, int size)
 
 static int pipe_read_internal(struct pipe *p, char *buffer, int size, int blocking)
 {
+	int read = 0;
+	int moved = 0;
+	int n;
+
 	if(!p || !buffer) {
 		return -1;
 	}
-	int read = 0;
-	if(blocking) {
-		for(read = 0; read < size; read++) {
-			while(p->write_pos == p->read_pos) {
-				if(p->flushed) {
-					p->flushed = 0;
-					return read;
-				}
-				if (blocking == 0) {
-					return -1;
-				}
-				process_wait(&p->queue);
-			}
-			buffer[read] = p->buffer[p->read_pos];
-			p->read_pos = (p->read_pos + 1) % PIPE_SIZE;
+
+	spinlock_acquire(&p->lock);
+	while(read < size) {
+		n = pipe_get(p, buffer + read, size - read);
+		if(n > 0) {
+			moved = 1;
+		} else {
+			n = pipe_get_direct(p, buffer + read, size - read);
 		}
-		process_wakeup_all(&p->queue);
-	} else {
-		while(read < size && p->read_pos != p->write_pos) {
-			buffer[read] = p->buffer[p->read_pos];
-			p->read_pos = (p->read_pos + 1) % PIPE_SIZE;
-			read++;
+		read += n;
+		if(read == size || !blocking) break;
+		if(n > 0) continue;
+		if(p->flushed) break;
+		if(moved) {
+			pipe_wake_writers(p);
+			poll_notify(&p->pollers);
+			moved = 0;
 		}
+		pipe_sleep(p, &p->readers, &p->read_want, size - read);
 	}
-	p->flushed = 0;
+	/* A flush that only cut this read short is kept, so the next read sees end of file. */
+	if(!read)
+		p->flushed = 0;
+	if(moved)
+		pipe_wake_writers(p);
+	spinlock_release(&p->lock);
+	if(moved)
+		poll_notify(&p->pollers);
 	return read;
 }
 
@@ -149,7 +417,69 @@ int pipe_read_nonblock(struct pipe *p, char *buffer, int size)
 	return pipe_read_internal(p, buffer, size, 0);
 }
 
+/*
+Return which of the requested events are ready: readable if there is
+data or a writer has flushed, writable if there is room.  If w is
+given, it is hung on the pipe to be woken by the next change.
+*/
+
+int pipe_poll(struct pipe *p, int events, struct poll_waiter *w)
+{
+	int ready = 0;
+
+	spinlock_acquire(&p->lock);
+	if(p->write_pos != p->read_pos || p->direct || p->flushed)
+		ready |= KERNEL_POLL_READ;
+	if(pipe_free(p) > 0)
+		ready |= KERNEL_POLL_WRITE;
+	if(w)
+		poll_register(&p->pollers, w);
+	spinlock_release(&p->lock);
+
+	return ready & events;
+}
+
 int pipe_size( struct pipe *p )
 {
-	return PIPE_SIZE;
+	return p->size;
+}
+
+/*
+Move the contents to a new ring of the given size, which must
+still hold everything not yet read.  Writers waiting for room
+are woken, since there may now be plenty.
+*/
+
+int pipe_resize( struct pipe *p, int size )
+{
+	int npages = pipe_pages(size);
+	char *buffer, *old;
+	int oldpages, used;
+
+	if(size <= 0 || npages > PIPE_MAX_PAGES) return KERROR_INVALID_REQUEST;
+
+	buffer = page_alloc_contiguous(npages, 0, MEMORY_TAG_PIPE);
+	if(!buffer) return KERROR_OUT_OF_MEMORY;
+
+	spinlock_acquire(&p->lock);
+	used = pipe_used(p);
+	if(used >= npages * PAGE_SIZE) {
+		spinlock_release(&p->lock);
+		page_free_contiguous(buffer, npages);
+		return KERROR_INVALID_REQUEST;
+	}
+	pipe_copy_out(p, buffer, used);
+	old = p->buffer;
+	oldpages = p->size / PAGE_SIZE;
+	p->buffer = buffer;
+	p->size = npages * PAGE_SIZE;
+	p->read_pos = 0;
+	p->write_pos = used;
+	process_wakeup_all(&p->writers);
+	spinlock_release(&p->lock);
+
+	page_free_contiguous(old, oldpages);
+	poll_notify(&p->pollers);
+
+	return 0;
 }
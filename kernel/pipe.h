@@ -3,7 +3,9 @@
 
 #include "kernel/types.h"
 
-struct pipe *pipe_create();
+#define PIPE_MAX_PAGES 64
+
+struct pipe *pipe_create(int size);
 struct pipe *pipe_addref( struct pipe *p );
 void pipe_delete(struct pipe *p);
 void pipe_flush(struct pipe *p);
@@ -13,5 +15,9 @@ int pipe_write_nonblock(struct pipe *p, char *buffer, int size);
 int pipe_read(struct pipe *p, char *buffer, int size);
 int pipe_read_nonblock(struct pipe *p, char *buffer, int size);
 int pipe_size( struct pipe *p);
+int pipe_resize( struct pipe *p, int size);
+
+struct poll_waiter;
+int pipe_poll(struct pipe *p, int events, struct poll_waiter *w);
 
 #endif
@@ -0,0 +1,168 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#include "poll.h"
+#include "process.h"
+#include "kobject.h"
+#include "kmalloc.h"
+#include "interrupt.h"
+#include "spinlock.h"
+#include "clock.h"
+#include "is_valid.h"
+#include "string.h"
+#include "kernel/error.h"
+
+/*
+A single lock covers every list of pollers and the wait queue
+of every poll_set.  Objects may notify from interrupt context,
+so it is always taken with interrupts blocked.
+*/
+
+static struct spinlock poll_lock = SPINLOCK_INIT;
+
+void poll_register(struct list *pollers, struct poll_waiter *w)
+{
+	int enabled = interrupt_block_save();
+	spinlock_acquire(&poll_lock);
+	if(!w->node.list)
+		list_push_tail(pollers, &w->node);
+	spinlock_release(&poll_lock);
+	interrupt_restore(enabled);
+}
+
+void poll_unregister(struct poll_waiter *w)
+{
+	int enabled = interrupt_block_save();
+	spinlock_acquire(&poll_lock);
+	list_remove(&w->node);
+	spinlock_release(&poll_lock);
+	interrupt_restore(enabled);
+}
+
+void poll_notify(struct list *pollers)
+{
+	struct list_node *n;
+	struct poll_waiter *w;
+
+	int enabled = interrupt_block_save();
+	spinlock_acquire(&poll_lock);
+	for(n = pollers->head; n; n = n->next) {
+		w = (struct poll_waiter *) n;
+		w->set->ready = 1;
+		process_wakeup(&w->set->queue);
+	}
+	spinlock_release(&poll_lock);
+	interrupt_restore(enabled);
+}
+
+/* Unhang and let go of everything a poll call was holding. */
+
+void poll_release(struct poll_call *c)
+{
+	int i;
+
+	for(i = 0; i < c->n; i++) {
+		if(c->objects[i]) {
+			poll_unregister(&c->waiters[i]);
+			kobject_release(c->objects[i]);
+		}
+	}
+
+	if(c->waiters) kfree(c->waiters);
+	if(c->objects) kfree(c->objects);
+	kfree(c);
+}
+
+/*
+Check each object of the current process named in fds, filling in
+revents, and sleep until at least one is ready or timeout millis
+have passed (forever, if negative).  A waiter is hung on each
+object the first time it is checked, and stays until the call returns.
+Returns the number of entries with non-zero revents.
+*/
+
+int poll_objects(struct kernel_poll *fds, int n, int timeout)
+{
+	struct poll_call *c;
+	clock_t start, elapsed;
+	int i, ready, remaining;
+	int expired = 0;
+
+	c = kmalloc_tag(sizeof(*c), MEMORY_TAG_PROCESS);
+	if(!c) return KERROR_OUT_OF_MEMORY;
+
+	memset(c, 0, sizeof(*c));
+	c->waiters = kmalloc_tag(n * sizeof(*c->waiters), MEMORY_TAG_PROCESS);
+	c->objects = kmalloc_tag(n * sizeof(*c->objects), MEMORY_TAG_PROCESS);
+	if(!c->waiters || !c->objects) {
+		poll_release(c);
+		return KERROR_OUT_OF_MEMORY;
+	}
+
+	memset(c->waiters, 0, n * sizeof(*c->waiters));
+
+	/* Hold the objects, in case another thread closes them while we sleep. */
+	for(i = 0; i < n; i++) {
+		c->waiters[i].set = &c->set;
+		c->objects[i] = is_valid_object(fds[i].fd) ? kobject_addref(current->space->ktable[fds[i].fd]) : 0;
+	}
+	c->n = n;
+	current->poll = c;
+
+	start = clock_read();
+
+	while(1) {
+		c->set.ready = 0;
+		ready = 0;
+
+		for(i = 0; i < n; i++) {
+			if(c->objects[i]) {
+				fds[i].revents = kobject_poll(c->objects[i], fds[i].events, &c->waiters[i]);
+			} else {
+				fds[i].revents = KERNEL_POLL_INVALID;
+			}
+			if(fds[i].revents)
+				ready++;
+		}
+
+		if(ready || timeout == 0 || expired)
+			break;
+
+		if(timeout > 0) {
+			elapsed = clock_diff(start, clock_read());
+			remaining = timeout - (int) (elapsed.seconds * 1000 + elapsed.millis);
+			if(remaining <= 0)
+				break;
+		} else {
+			remaining = -1;
+		}
+
+		interrupt_block();
+		spinlock_acquire(&poll_lock);
+
+		/* Something changed since we looked, so look again. */
+		if(c->set.ready) {
+			spinlock_release(&poll_lock);
+			interrupt_unblock();
+			continue;
+		}
+
+		if(remaining >= 0)
+			clock_timer_start(&current->timer, current, remaining);
+
+		process_wait_locked(&c->set.queue, &poll_lock);
+
+		if(remaining >= 0) {
+			clock_timer_cancel(&current->timer);
+			expired = current->timer.expired;
+		}
+	}
+
+	current->poll = 0;
+	poll_release(c);
+
+	return ready;
+}
@@ -0,0 +1,56 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#ifndef POLL_H
+#define POLL_H
+
+#include "kernel/types.h"
+#include "list.h"
+
+/*
+A process polling several objects at once cannot sleep on all of
+their wait queues, so instead it hangs a poll_waiter on a list of
+pollers kept by each object.  When an object may have become
+readable or writable, it calls poll_notify on that list, which
+wakes every poll_set with a waiter there.  The poller then checks
+all of its objects again.
+*/
+
+struct poll_set {
+	struct list queue;
+	int ready;
+};
+
+struct poll_waiter {
+	struct list_node node;
+	struct poll_set *set;
+};
+
+/*
+The state of one call to poll_objects belongs to the polling
+process rather than its stack.  A process killed while asleep in
+poll never returns to unhang its waiters, so they stay on the
+objects, pointing at a set that is still valid, until
+process_delete calls poll_release.
+*/
+
+struct kobject;
+
+struct poll_call {
+	struct poll_set set;
+	struct poll_waiter *waiters;
+	struct kobject **objects;
+	int n;
+};
+
+void poll_register(struct list *pollers, struct poll_waiter *w);
+void poll_unregister(struct poll_waiter *w);
+void poll_notify(struct list *pollers);
+void poll_release(struct poll_call *c);
+
+int poll_objects(struct kernel_poll *fds, int n, int timeout);
+
+#endif
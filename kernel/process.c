@@ -18,9 +18,29 @@ See the file LICENSE for details.
 #include "main.h"
 #include "keyboard.h"
 #include "clock.h"
+#include "kernel/error.h"
+#include "cpu.h"
+#include "apic.h"
+#include "spinlock.h"
+#include "elf.h"
+#include "poll.h"
 
-struct process *current = 0;
-struct list ready_list = { 0, 0 };
+#define PROCESS_QUANTUM_CLICKS MAX(1, PROCESS_QUANTUM_MILLIS * CLICKS_PER_SECOND / 1000)
+#define PROCESS_BOOST_CLICKS (PROCESS_BOOST_MILLIS * CLICKS_PER_SECOND / 1000)
+
+/*
+Each CPU has its own run queue, so that a process tends to stay
+where its cache is warm.  A CPU with nothing of its own to run
+steals from the busiest queue before going idle.
+*/
+
+struct run_queue {
+	struct spinlock lock;
+	struct list ready[PROCESS_PRIORITY_LEVELS];
+	int count;
+};
+
+static struct run_queue run_queues[CPU_MAX];
 struct list grave_list = { 0, 0 };
 struct list grave_watcher_list = { 0, 0 };	// parent processes are put here to wait for their children
 struct process *process_table[PROCESS_MAX_PID] = { 0 };
@@ -81,61 +101,168 @@ Valid pids start at 1 and go to PROCESS_MAX_PID.
 To avoid confusion, keep picking increasing
 pids until it is necessary to wrap around.
 "last" is the most recently selected pid.
+Pids in use are kept in a bitmap, so that a free
+one is found a word at a time.  Pid zero is never used.
 */
 
+static uint32_t process_pid_bitmap[PROCESS_MAX_PID / 32] = { 1 };
+
+/* Return the first free pid in [start,end), or zero if there is none. */
+
+static int process_pid_search(int start, int end)
+{
+	int i = start;
+
+	while(i < end) {
+		uint32_t free = ~process_pid_bitmap[i / 32] >> (i % 32);
+		if(free) {
+			i += __builtin_ctz(free);
+			return i < end ? i : 0;
+		}
+		i = (i | 31) + 1;
+	}
+
+	return 0;
+}
+
 static int process_allocate_pid()
 {
 	static int last = 0;
 
-	int i;
+	int i = process_pid_search(last + 1, PROCESS_MAX_PID);
+	if(!i)
+		i = process_pid_search(1, last);
+	if(!i)
+		return 0;
 
-	for(i = last + 1; i < PROCESS_MAX_PID; i++) {
-		if(!process_table[i]) {
-			last = i;
-			return i;
-		}
+	process_pid_bitmap[i / 32] |= 1u << (i % 32);
+	last = i;
+	return i;
+}
+
+static void process_free_pid(int pid)
+{
+	if(pid > 0)
+		process_pid_bitmap[pid / 32] &= ~(1u << (pid % 32));
+}
+
+/*
+Each address space has an object table of ktable_size slots,
+along with a bitmap of the slots in use, so that the lowest free
+descriptor is found a word at a time.  Every word below kfirst
+is known to be full.  The table doubles when it runs out of room.
+Entries must be changed with process_object_set to keep the
+bitmap up to date.
+*/
+
+static int process_object_grow(struct process_space *s, int size)
+{
+	struct kobject **table;
+	uint32_t *bitmap;
+	int newsize = MAX(s->ktable_size, PROCESS_MIN_OBJECTS);
+
+	if(size <= s->ktable_size)
+		return 0;
+	if(size > PROCESS_MAX_OBJECTS)
+		return KERROR_OUT_OF_OBJECTS;
+
+	while(newsize < size)
+		newsize *= 2;
+	newsize = MIN(newsize, PROCESS_MAX_OBJECTS);
+
+	table = kmalloc_tag(newsize * sizeof(*table), MEMORY_TAG_PROCESS);
+	bitmap = kmalloc_tag(newsize / 32 * sizeof(*bitmap), MEMORY_TAG_PROCESS);
+	if(!table || !bitmap) {
+		if(table) kfree(table);
+		if(bitmap) kfree(bitmap);
+		return KERROR_OUT_OF_MEMORY;
 	}
 
-	for(i = 1; i < last; i++) {
-		if(!process_table[i]) {
-			last = i;
-			return i;
-		}
+	memset(table, 0, newsize * sizeof(*table));
+	memset(bitmap, 0, newsize / 32 * sizeof(*bitmap));
+
+	if(s->ktable) {
+		memcpy(table, s->ktable, s->ktable_size * sizeof(*table));
+		memcpy(bitmap, s->kbitmap, s->ktable_size / 32 * sizeof(*bitmap));
+		kfree(s->ktable);
+		kfree(s->kbitmap);
 	}
 
+	s->ktable = table;
+	s->kbitmap = bitmap;
+	s->ktable_size = newsize;
+
 	return 0;
 }
 
+/* Make sure that descriptor fd has a slot in the table. */
+
+int process_object_reserve(struct process *p, int fd)
+{
+	return process_object_grow(p->space, fd + 1);
+}
+
+void process_object_set(struct process *p, int fd, struct kobject *k)
+{
+	struct process_space *s = p->space;
+
+	s->ktable[fd] = k;
+	if(k) {
+		s->kbitmap[fd / 32] |= 1u << (fd % 32);
+	} else {
+		s->kbitmap[fd / 32] &= ~(1u << (fd % 32));
+		if(fd / 32 < s->kfirst)
+			s->kfirst = fd / 32;
+	}
+}
+
+static void process_adopt(struct process *parent, struct process *child)
+{
+	child->ppid = parent->pid;
+	if(!child->parent) {
+		child->parent = parent;
+		list_push_tail(&parent->children, &child->sibling);
+	}
+}
+
 void process_selective_inherit(struct process *parent, struct process *child, int * fds, int length)
 {
 	int i;
 
-	for (i=0;i<length;i++) {
-		if(fds[i]>-1) {
-			child->ktable[i] = kobject_copy(parent->ktable[fds[i]]);
+	process_object_reserve(child, length - 1);
+
+	for (i=0;i<length && i<child->space->ktable_size;i++) {
+		if(fds[i]>-1 && fds[i]<parent->space->ktable_size && parent->space->ktable[fds[i]]) {
+			process_object_set(child, i, kobject_copy(parent->space->ktable[fds[i]]));
+			kobject_map(child->space->ktable[i], child->pagetable);
 		} else {
-			child->ktable[i] = 0;
+			process_object_set(child, i, 0);
 		}
 	}
 
-	child->ppid = parent->pid;
+	process_adopt(parent, child);
 }
 
+/* Child inherits everything parent inherits, visiting only the slots in use. */
+
 void process_inherit(struct process *parent, struct process *child)
 {
-	/* Child inherits everything parent inherits */
-	int i;
-	int * fds = kmalloc(sizeof(int)*PROCESS_MAX_OBJECTS);
-	for (i = 0; i < PROCESS_MAX_OBJECTS; i++)
-	{
-		if (parent->ktable[i]) {
-			fds[i] = i;
-		} else {
-			fds[i] = -1;
+	struct process_space *s = parent->space;
+	int i, fd;
+
+	process_object_reserve(child, s->ktable_size - 1);
+
+	for(i = 0; i < s->ktable_size / 32; i++) {
+		uint32_t used = s->kbitmap[i];
+		while(used) {
+			fd = i * 32 + __builtin_ctz(used);
+			used &= used - 1;
+			process_object_set(child, fd, kobject_copy(s->ktable[fd]));
+			kobject_map(child->space->ktable[fd], child->pagetable);
 		}
 	}
-	process_selective_inherit(parent, child, fds, PROCESS_MAX_OBJECTS);
-	kfree(fds);
+
+	process_adopt(parent, child);
 }
 
 int process_data_size_set(struct process *p, unsigned size)
@@ -147,18 +274,51 @@ int process_data_size_set(struct process *p, unsigned size)
 		size += (PAGE_SIZE - size % PAGE_SIZE);
 	}
 
-	if(size > p->vm_data_size) {
-		uint32_t start = PROCESS_ENTRY_POINT + p->vm_data_size;
-		pagetable_alloc(p->pagetable, start, size, PAGE_FLAG_USER | PAGE_FLAG_READWRITE | PAGE_FLAG_CLEAR);
-	} else if(size < p->vm_data_size) {
+	if(size > p->space->vm_data_size) {
+		uint32_t start = PROCESS_ENTRY_POINT + p->space->vm_data_size;
+		int flags = PAGE_FLAG_USER | PAGE_FLAG_READWRITE | PAGE_FLAG_CLEAR;
+		if(size - p->space->vm_data_size >= PROCESS_LARGE_PAGE_SIZE)
+			flags |= PAGE_FLAG_LARGE;
+		pagetable_alloc(p->pagetable, start, size - p->space->vm_data_size, flags);
+	} else if(size < p->space->vm_data_size) {
 		uint32_t start = PROCESS_ENTRY_POINT + size;
-		pagetable_free(p->pagetable, start, p->vm_data_size);
+		pagetable_free(p->pagetable, start, p->space->vm_data_size - size);
 	} else {
 		// requested size is equal to current.
 	}
 
-	p->vm_data_size = size;
-	pagetable_refresh();
+	/*
+	Growing only fills in previously absent entries, and shrinking
+	invalidates what it unmaps, so no full TLB flush is needed here.
+	*/
+
+	p->space->vm_data_size = size;
+
+	return 0;
+}
+
+/*
+Unlike process_data_size_set, growing the data segment here
+only reserves the virtual range: pages are mapped and zeroed
+by the page fault handler when first touched.
+*/
+
+int process_data_size_reserve(struct process *p, unsigned size)
+{
+	if(size % PAGE_SIZE) {
+		size += (PAGE_SIZE - size % PAGE_SIZE);
+	}
+
+	if(size > PROCESS_DATA_LIMIT - PROCESS_ENTRY_POINT) {
+		return KERROR_OUT_OF_MEMORY;
+	}
+
+	if(size < p->space->vm_data_size) {
+		uint32_t start = PROCESS_ENTRY_POINT + size;
+		pagetable_free(p->pagetable, start, p->space->vm_data_size - size);
+	}
+
+	p->space->vm_data_size = size;
 
 	return 0;
 }
@@ -168,16 +328,15 @@ int process_stack_size_set(struct process *p, unsigned size)
 	// XXX check valid ranges
 	// XXX round up to page size
 
-	if(size > p->vm_stack_size) {
+	if(size > p->space->vm_stack_size) {
 		uint32_t start = -size;
-		pagetable_alloc(p->pagetable, start, size - p->vm_stack_size, PAGE_FLAG_USER | PAGE_FLAG_READWRITE | PAGE_FLAG_CLEAR);
+		pagetable_alloc(p->pagetable, start, size - p->space->vm_stack_size, PAGE_FLAG_USER | PAGE_FLAG_READWRITE | PAGE_FLAG_CLEAR);
 	} else {
-		uint32_t start = -p->vm_stack_size;
-		pagetable_free(p->pagetable, start, p->vm_stack_size - size);
+		uint32_t start = -p->space->vm_stack_size;
+		pagetable_free(p->pagetable, start, p->space->vm_stack_size - size);
 	}
 
-	p->vm_stack_size = size;
-	pagetable_refresh();
+	p->space->vm_stack_size = size;
 
 	return 0;
 }
@@ -192,97 +351,547 @@ struct process *process_create()
 {
 	struct process *p;
 
-	p = page_alloc(1);
+	p = page_alloc_tag(1, MEMORY_TAG_PROCESS);
 
 	p->pid = process_allocate_pid();
 	process_table[p->pid] = p;
 
+	p->space = kmalloc_tag(sizeof(*p->space), MEMORY_TAG_PROCESS);
+	p->space->refcount = 1;
+
 	p->pagetable = pagetable_create();
 	pagetable_init(p->pagetable);
 
-	p->vm_data_size = 0;
-	p->vm_stack_size = 0;
+	p->space->vm_data_size = 0;
+	p->space->vm_stack_size = 0;
+	p->space->image = 0;
+	p->space->ktable = 0;
+	p->space->kbitmap = 0;
+	p->space->ktable_size = 0;
+	p->space->kfirst = 0;
+	process_object_grow(p->space, PROCESS_MIN_OBJECTS);
 
 	process_data_size_set(p, 2 * PAGE_SIZE);
 	process_stack_size_set(p, 2 * PAGE_SIZE);
 
-	p->kstack = page_alloc(1);
+	if(clock_time_page())
+		pagetable_map(p->pagetable, PROCESS_TIME_PAGE, (unsigned) clock_time_page(), PAGE_FLAG_USER | PAGE_FLAG_READONLY);
+
+	p->kstack = page_alloc_tag(1, MEMORY_TAG_PROCESS);
 	p->kstack_top = p->kstack + PAGE_SIZE - 8;
 	p->kstack_ptr = p->kstack_top - sizeof(struct x86_stack);
 
 	process_kstack_reset(p, PROCESS_ENTRY_POINT);
 
-	// XXX table should be allocated
-	int i;
-	for(i = 0; i < PROCESS_MAX_OBJECTS; i++) {
-		p->ktable[i] = 0;
-	}
+	p->nice = current ? current->nice : 0;
+	p->priority = p->nice;
 
 	p->state = PROCESS_STATE_READY;
 
 	return p;
 }
 
+static void process_kthread_start()
+{
+	current->kthread_entry(current->kthread_arg);
+	process_exit(0);
+}
+
+/*
+A kernel thread has no user memory: it runs entirely in the kernel,
+on the page table that idle CPUs use, starting at entry(arg) with
+the kernel lock held once, and it exits when entry returns.
+It is detached, so it is deleted as soon as it exits.
+The caller must process_launch it.
+*/
+
+struct process *process_create_kernel(void (*entry)(void *arg), void *arg)
+{
+	struct process *p;
+	struct x86_stack *s;
+
+	p = page_alloc_tag(1, MEMORY_TAG_PROCESS);
+	if(!p)
+		return 0;
+
+	p->kstack = page_alloc_tag(1, MEMORY_TAG_PROCESS);
+	if(!p->kstack) {
+		page_free(p);
+		return 0;
+	}
+
+	p->pid = process_allocate_pid();
+	process_table[p->pid] = p;
+
+	p->pagetable = cpu_idle_pagetable;
+	p->kthread_entry = entry;
+	p->kthread_arg = arg;
+	p->kernel_depth = 1;
+	p->detached = 1;
+
+	/* The first switch to the thread returns from process_switch into process_kthread_start. */
+	p->kstack_top = p->kstack + PAGE_SIZE - 8;
+	p->kstack_ptr = p->kstack_top - sizeof(struct x86_stack);
+
+	s = (struct x86_stack *) p->kstack_ptr;
+	s->regs2.ebp = (uint32_t) (p->kstack_ptr + 28);
+	s->old_ebp = 0;
+	s->old_eip = (unsigned) process_kthread_start;
+
+	p->state = PROCESS_STATE_CRADLE;
+
+	return p;
+}
+
+/*
+A user thread shares the address space and objects of parent,
+and starts at entry_point on a stack that the caller has already
+set up in that address space.  It has no parent process: another
+thread of the same program collects it with process_join.
+The caller must process_launch it.
+*/
+
+struct process *process_create_thread(struct process *parent, unsigned entry_point, unsigned stack)
+{
+	struct process *p;
+	struct x86_stack *s;
+
+	p = page_alloc_tag(1, MEMORY_TAG_PROCESS);
+	if(!p)
+		return 0;
+
+	p->kstack = page_alloc_tag(1, MEMORY_TAG_PROCESS);
+	if(!p->kstack) {
+		page_free(p);
+		return 0;
+	}
+
+	p->pid = process_allocate_pid();
+	process_table[p->pid] = p;
+
+	p->space = parent->space;
+	p->space->refcount++;
+	p->pagetable = parent->pagetable;
+
+	p->kstack_top = p->kstack + PAGE_SIZE - 8;
+	p->kstack_ptr = p->kstack_top - sizeof(struct x86_stack);
+	process_kstack_reset(p, entry_point);
+
+	s = (struct x86_stack *) p->kstack_ptr;
+	s->esp = stack;
+
+	p->nice = parent->nice;
+	p->priority = p->nice;
+
+	return p;
+}
+
+static struct process *process_from_sibling(struct list_node *n)
+{
+	return (struct process *) ((char *) n - (unsigned) &((struct process *) 0)->sibling);
+}
+
+/*
+Detach a process from its parent, and orphan its own children,
+moving any that have already exited to the global grave list.
+*/
+
+static void process_unlink_family(struct process *p)
+{
+	struct process *c;
+	struct list_node *n;
+
+	list_remove(&p->sibling);
+	p->parent = 0;
+
+	while((n = list_pop_head(&p->children))) {
+		c = process_from_sibling(n);
+		c->parent = 0;
+		if(c->node.list == &p->zombies) {
+			list_remove(&c->node);
+			list_push_tail(&grave_list, &c->node);
+		}
+	}
+}
+
 void process_delete(struct process *p)
 {
 	int i;
-	for(i = 0; i < PROCESS_MAX_OBJECTS; i++) {
-		if(p->ktable[i]) {
-			kobject_close(p->ktable[i]);
+	uint32_t pid = p->pid;
+
+	process_unlink_family(p);
+
+	/* Killed while asleep in poll, it left its waiters hung on objects. */
+	if(p->poll) poll_release(p->poll);
+
+	if(p->space && --p->space->refcount == 0) {
+		for(i = 0; i < p->space->ktable_size; i++) {
+			if(p->space->ktable[i]) {
+				kobject_close(p->space->ktable[i]);
+			}
 		}
+		pagetable_delete(p->pagetable);
+		elf_image_release(p->space->image);
+		kfree(p->space->ktable);
+		kfree(p->space->kbitmap);
+		kfree(p->space);
 	}
-	pagetable_delete(p->pagetable);
 	page_free(p->kstack);
 	page_free(p);
-	process_table[p->pid] = 0;
+	process_table[pid] = 0;
+	process_free_pid(pid);
 }
 
-void process_launch(struct process *p)
+/*
+A newly ready process may have landed on the queue of a halted CPU,
+or on a busy one while another CPU sits idle and could steal it.
+*/
+
+static void process_kick(int id)
 {
-	list_push_tail(&ready_list, &p->node);
+	int i;
+
+	if(cpus[id].idle) {
+		cpu_wake(&cpus[id]);
+		return;
+	}
+
+	for(i = 0; i < cpu_count; i++) {
+		if(cpus[i].idle) {
+			cpu_wake(&cpus[i]);
+			return;
+		}
+	}
 }
 
-static void process_switch(int newstate)
+/*
+Place a process on the ready queue for its current priority,
+on the CPU where it last ran.  This may be called from an interrupt.
+*/
+
+static void process_ready(struct process *p)
+{
+	struct run_queue *q = &run_queues[p->cpu];
+	int enabled = interrupt_block_save();
+
+	p->state = PROCESS_STATE_READY;
+	p->ready_since = clock_nanos();
+
+	spinlock_acquire(&q->lock);
+	list_push_tail(&q->ready[p->priority], &p->node);
+	q->count++;
+	spinlock_release(&q->lock);
+
+	process_kick(p->cpu);
+
+	interrupt_restore(enabled);
+}
+
+/*
+Return the most urgent level with a process ready to run,
+or PROCESS_PRIORITY_LEVELS if nothing is ready.
+*/
+
+static int process_ready_level(struct run_queue *q)
+{
+	int i;
+	for(i = 0; i < PROCESS_PRIORITY_LEVELS; i++) {
+		if(q->ready[i].head)
+			return i;
+	}
+	return PROCESS_PRIORITY_LEVELS;
+}
+
+static struct process *process_ready_take(struct run_queue *q)
 {
+	struct process *p = 0;
+	int i;
+
+	spinlock_acquire(&q->lock);
+	i = process_ready_level(q);
+	if(i < PROCESS_PRIORITY_LEVELS) {
+		p = (struct process *) list_pop_head(&q->ready[i]);
+		q->count--;
+	}
+	spinlock_release(&q->lock);
+
+	return p;
+}
+
+/* Take a ready process off its queue before it gets to run. */
+
+static void process_ready_remove(struct process *p)
+{
+	struct run_queue *q = &run_queues[p->cpu];
+	int enabled = interrupt_block_save();
+
+	spinlock_acquire(&q->lock);
+	list_remove(&p->node);
+	q->count--;
+	spinlock_release(&q->lock);
+
+	interrupt_restore(enabled);
+}
+
+/*
+Take the next process for CPU c from its own queue,
+or else from whichever other queue is longest.
+Called with interrupts blocked.
+*/
+
+static struct process *process_ready_pop(struct cpu *c)
+{
+	struct process *p;
+	int i, busiest = -1;
+
+	p = process_ready_take(&run_queues[c->id]);
+
+	if(!p) {
+		for(i = 0; i < cpu_count; i++) {
+			if(i != c->id && run_queues[i].count > 0 && (busiest < 0 || run_queues[i].count > run_queues[busiest].count))
+				busiest = i;
+		}
+		if(busiest >= 0)
+			p = process_ready_take(&run_queues[busiest]);
+	}
+
+	if(p)
+		p->cpu = c->id;
+
+	return p;
+}
+
+static int process_cpu_load(int id)
+{
+	return run_queues[id].count + (cpus[id].process ? 1 : 0);
+}
+
+static void process_account_wait(struct process *p, uint64_t wait)
+{
+	int bucket = 0;
+	uint64_t limit = 10000;
+
+	while(bucket < PROCESS_WAIT_BUCKETS - 1 && wait >= limit) {
+		bucket++;
+		limit *= 10;
+	}
+
+	p->wait_nanos += wait;
+	p->stats.wait_histogram[bucket]++;
+}
+
+/*
+Idle time is measured around each halt, and the utilization
+figure is recomputed once a second from the idle time within it.
+*/
+
+#define IDLE_WINDOW_NANOS 1000000000
+
+static uint64_t idle_nanos = 0;
+static uint64_t idle_window_start = 0;
+static uint64_t idle_window_nanos = 0;
+static uint32_t idle_utilization = 0;
+
+static void process_idle_window(uint64_t now)
+{
+	uint64_t elapsed = (now - idle_window_start) * cpu_count;
+	uint64_t idle = idle_nanos - idle_window_nanos;
+	uint32_t busy;
+
+	if(now - idle_window_start < IDLE_WINDOW_NANOS)
+		return;
+
+	/* An idle period is credited when it ends, so it may overlap the previous window. */
+	busy = idle < elapsed ? clock_divide(elapsed - idle, 1000, 0) : 0;
+	idle_utilization = clock_divide((uint64_t) busy * 100, clock_divide(elapsed, 1000, 0), 0);
+
+	idle_window_start = now;
+	idle_window_nanos = idle_nanos;
+}
+
+/*
+Halt until the next interrupt, with the clock only set to wake
+us when a timer is due.  The boot CPU owns the system clock;
+the others stop their timers and wait to be woken by another
+CPU with work for them.  Called with interrupts blocked and
+the kernel lock held, which is let go while halted.
+*/
+
+static void process_idle(struct cpu *c)
+{
+	uint64_t start = clock_nanos();
+	uint64_t stop;
+	int depth;
+
+	/* Don't keep a page table that its owner may be about to free. */
+	pagetable_load(cpu_idle_pagetable);
+
+	if(c->id == 0) {
+		clock_idle_begin();
+	} else {
+		apic_timer_stop();
+	}
+
+	c->idle = 1;
+	depth = kernel_lock_depth();
+	kernel_lock_set_depth(0);
+
+	interrupt_wait();
 	interrupt_block();
 
-	if(current) {
-		if(current->state != PROCESS_STATE_CRADLE) {
-			asm("pushl %ebp");
-			asm("pushl %edi");
-			asm("pushl %esi");
-			asm("pushl %edx");
-			asm("pushl %ecx");
-			asm("pushl %ebx");
-			asm("pushl %eax");
-		      asm("movl %%esp, %0":"=r"(current->kstack_ptr));
+	kernel_lock_set_depth(depth);
+	c->idle = 0;
+
+	if(c->id == 0) {
+		clock_idle_end();
+	} else {
+		apic_timer_start();
+	}
+
+	stop = clock_nanos();
+	idle_nanos += stop - start;
+	process_idle_window(stop);
+}
+
+void process_idle_stats(uint32_t *idle_millis, uint32_t *utilization)
+{
+	interrupt_block();
+	process_idle_window(clock_nanos());
+	*idle_millis = clock_divide(idle_nanos, 1000000, 0);
+	*utilization = idle_utilization;
+	interrupt_unblock();
+}
+
+static int boost_clicks = 0;
+static int boost_pending = 0;
+
+/*
+Return every process to its base level, moving the
+ready ones to the corresponding queues.
+*/
+
+static void process_boost_all()
+{
+	int i, n, c;
+	struct process *p;
+
+	for(i = 0; i < PROCESS_MAX_PID; i++) {
+		p = process_table[i];
+		if(p)
+			p->priority = p->nice;
+	}
+
+	for(c = 0; c < cpu_count; c++) {
+		struct run_queue *q = &run_queues[c];
+		spinlock_acquire(&q->lock);
+		for(i = 1; i < PROCESS_PRIORITY_LEVELS; i++) {
+			n = list_size(&q->ready[i]);
+			while(n-- > 0) {
+				p = (struct process *) list_pop_head(&q->ready[i]);
+				list_push_tail(&q->ready[p->priority], &p->node);
+			}
 		}
+		spinlock_release(&q->lock);
+	}
+
+	boost_pending = 0;
+}
 
-		interrupt_stack_pointer = (void *) INTERRUPT_STACK_TOP;
-		current->state = newstate;
+/*
+A new process starts on the least loaded CPU, so that
+parallel work spreads out without waiting to be stolen.
+*/
 
-		if(newstate == PROCESS_STATE_READY) {
-			list_push_tail(&ready_list, &current->node);
+void process_launch(struct process *p)
+{
+	int i, best = 0;
+
+	for(i = 1; i < cpu_count; i++) {
+		if(process_cpu_load(i) < process_cpu_load(best))
+			best = i;
+	}
+
+	p->cpu = best;
+	process_ready(p);
+}
+
+/*
+Once the outgoing process is saved, the rest of the switch runs on
+the scheduler stack of this CPU, so that another CPU may resume the
+outgoing process as soon as it is on a queue.  The incoming process
+continues at the end of this function, on its own kernel stack,
+holding the kernel lock as deeply as it did when it left.
+process_switch must not use callee-saved registers of its own,
+since they are restored only through the pushes below.
+*/
+
+/*
+A process that has exited waits for its parent, if it still has
+one, or on the global grave list otherwise.  Detached processes
+have no one waiting for them and are deleted right away.
+*/
+
+static void process_bury(struct process *p)
+{
+	if(p->detached) {
+		process_delete(p);
+	} else if(p->parent) {
+		list_push_tail(&p->parent->zombies, &p->node);
+	} else {
+		list_push_tail(&grave_list, &p->node);
+	}
+}
+
+static void process_schedule()
+{
+	struct cpu *c = cpu_self();
+	struct process *p = c->prev;
+
+	if(p) {
+		c->prev = 0;
+		p->kernel_nanos += clock_nanos() - p->mark;
+		p->kernel_depth = kernel_lock_depth();
+
+		if(c->prev_state == PROCESS_STATE_READY) {
+			process_ready(p);
+		} else {
+			p->state = c->prev_state;
 		}
-		if(newstate == PROCESS_STATE_GRAVE) {
-			list_push_tail(&grave_list, &current->node);
+		if(c->prev_state == PROCESS_STATE_GRAVE) {
+			/*
+			Safe now that we are off its stack.  A detached process
+			is deleted right away, page table and all, so stop
+			using its page table first, as process_idle does.
+			*/
+			pagetable_load(cpu_idle_pagetable);
+			process_bury(p);
 		}
 	}
 
+	if(c->prev_lock) {
+		spinlock_release(c->prev_lock);
+		c->prev_lock = 0;
+	}
+
 	current = 0;
+	c->tss.esp0 = (int32_t) c->stack_top;
 
 	while(1) {
-		current = (struct process *) list_pop_head(&ready_list);
+		if(boost_pending)
+			process_boost_all();
+		current = process_ready_pop(c);
 		if(current)
 			break;
 
-		interrupt_unblock();
-		interrupt_wait();
-		interrupt_block();
+		process_idle(c);
 	}
 
 	current->state = PROCESS_STATE_RUNNING;
-	interrupt_stack_pointer = current->kstack_top;
+	current->quantum = PROCESS_QUANTUM_CLICKS << current->priority;
+	current->mark = clock_nanos();
+	process_account_wait(current, current->mark - current->ready_since);
+	c->tss.esp0 = (int32_t) current->kstack_top;
+	kernel_lock_set_depth(current->kernel_depth);
 
 	asm("movl %0, %%cr3"::"r"(current->pagetable));
 	asm("movl %0, %%esp"::"r"(current->kstack_ptr));
@@ -295,14 +904,144 @@ static void process_switch(int newstate)
 	asm("popl %edi");
 	asm("popl %ebp");
 
-	interrupt_unblock();
+	/*
+	Return from process_switch through the frame that the incoming
+	process left behind, rather than through our own epilogue,
+	which would restore registers from the wrong frame.
+	*/
+
+	asm("sti");
+	asm("leave");
+	asm("ret");
 }
 
-int allow_preempt = 0;
+static void process_switch(int newstate)
+{
+	struct cpu *c;
+
+	interrupt_block();
+	c = cpu_self();
+
+	if(current) {
+		if(current->state != PROCESS_STATE_CRADLE) {
+			asm("pushl %ebp");
+			asm("pushl %edi");
+			asm("pushl %esi");
+			asm("pushl %edx");
+			asm("pushl %ecx");
+			asm("pushl %ebx");
+			asm("pushl %eax");
+		      asm("movl %%esp, %0":"=r"(current->kstack_ptr));
+		}
+
+		c->prev = current;
+		c->prev_state = newstate;
+	}
+
+	asm("movl %0, %%esp"::"r"(c->stack_top));
+	process_schedule();
+}
+
+/*
+Called by each secondary CPU, holding the kernel lock,
+to begin running processes.
+*/
+
+void process_cpu_start()
+{
+	interrupt_block();
+	process_schedule();
+}
+
+int allow_preempt = 1;
+
+/*
+Called on every clock interrupt to charge the running process
+for one click of its quantum, and to schedule the periodic boost.
+*/
+
+void process_tick()
+{
+	if(current && current->quantum > 0)
+		current->quantum--;
+
+	/* The boot CPU keeps time for the whole system. */
+	if(cpu_self()->id != 0)
+		return;
+
+	process_idle_window(clock_nanos());
+
+	if(++boost_clicks >= PROCESS_BOOST_CLICKS) {
+		boost_clicks = 0;
+		boost_pending = 1;
+	}
+}
+
+/*
+Time is charged to the current process as user time until it
+enters the kernel through a syscall or interrupt, and as kernel
+time from then until it returns to user mode or switches away.
+*/
+
+void process_enter_kernel()
+{
+	if(current) {
+		uint64_t now = clock_nanos();
+		current->user_nanos += now - current->mark;
+		current->mark = now;
+	}
+}
+
+void process_leave_kernel()
+{
+	if(current) {
+		uint64_t now = clock_nanos();
+		current->kernel_nanos += now - current->mark;
+		current->mark = now;
+	}
+}
+
+/*
+A process killed while it ran on another CPU is only marked,
+since it cannot be taken off that CPU from here.  It checks the
+mark on the way back to user mode and before and after every
+sleep, so that it cannot block where no one will wake it.
+*/
+
+void process_exit_if_killed()
+{
+	if(!current || !current->killed)
+		return;
+
+	clock_timer_cancel(&current->timer);
+	process_wakeup_parent(&grave_watcher_list);
+	process_switch(PROCESS_STATE_GRAVE);
+}
+
+/*
+Give up the CPU if a more urgent process is ready, or if the
+quantum has run out and anyone else is waiting.  Using up the
+whole quantum costs a level.  This must only be called where
+a switch is safe: the interrupt handler calls it on the way
+back to user mode.
+*/
 
 void process_preempt()
 {
-	if(allow_preempt && current && ready_list.head) {
+	if(!allow_preempt || !current)
+		return;
+
+	process_exit_if_killed();
+
+	int level = process_ready_level(&run_queues[cpu_self()->id]);
+
+	if(current->quantum <= 0 && level < PROCESS_PRIORITY_LEVELS) {
+		if(current->priority < PROCESS_PRIORITY_LEVELS - 1)
+			current->priority++;
+		current->stats.involuntary_switches++;
+		process_switch(PROCESS_STATE_READY);
+	} else if(level < current->priority) {
+		current->stats.involuntary_switches++;
 		process_switch(PROCESS_STATE_READY);
 	}
 }
@@ -311,6 +1050,7 @@ void process_yield()
 {
 	/* no-op if process module not yet initialized. */
 	if(!current) return;
+	current->stats.voluntary_switches++;
 	process_switch(PROCESS_STATE_READY);
 }
 
@@ -325,8 +1065,75 @@ void process_exit(int code)
 
 void process_wait(struct list *q)
 {
+	process_exit_if_killed();
+	list_push_tail(q, &current->node);
+	current->stats.voluntary_switches++;
+	process_switch(PROCESS_STATE_BLOCKED);
+	process_exit_if_killed();
+}
+
+/*
+Wait on q, which is protected by lock.  The lock is released
+only once this process is off the CPU, so that a wakeup cannot
+slip in between testing a condition and going to sleep.
+The lock is not held on return.
+*/
+
+void process_wait_locked(struct list *q, struct spinlock *lock)
+{
+	interrupt_block();
+	cpu_self()->prev_lock = lock;
+	process_exit_if_killed();
 	list_push_tail(q, &current->node);
+	current->stats.voluntary_switches++;
 	process_switch(PROCESS_STATE_BLOCKED);
+	process_exit_if_killed();
+}
+
+
+/*
+Wait on q for no more than millis (or forever, if negative.)
+Returns true if the wait timed out rather than being woken.
+*/
+
+int process_wait_timeout(struct list *q, int millis)
+{
+	if(millis < 0) {
+		process_wait(q);
+		return 0;
+	}
+
+	interrupt_block();
+	clock_timer_start(&current->timer, current, millis);
+	process_wait(q);
+	clock_timer_cancel(&current->timer);
+
+	return current->timer.expired;
+}
+
+/*
+Wait for input on behalf of a user: when woken, the process
+goes back to its base level so that it responds promptly.
+*/
+
+int process_wait_interactive(struct list *q, int millis)
+{
+	current->priority = current->nice;
+	return process_wait_timeout(q, millis);
+}
+
+/*
+Take a blocked process off whatever queue it waits on
+and make it ready.  Used by timers, so it must be safe
+to call from an interrupt.
+*/
+
+void process_unblock(struct process *p)
+{
+	if(p->state == PROCESS_STATE_BLOCKED) {
+		list_remove(&p->node);
+		process_ready(p);
+	}
 }
 
 void process_wakeup(struct list *q)
@@ -334,8 +1141,7 @@ void process_wakeup(struct list *q)
 	struct process *p;
 	p = (struct process *) list_pop_head(q);
 	if(p) {
-		p->state = PROCESS_STATE_READY;
-		list_push_tail(&ready_list, &p->node);
+		process_ready(p);
 	}
 }
 
@@ -353,11 +1159,10 @@ void process_wakeup_parent(struct list *q)
 	struct process *p = (struct process *) q->head;
 	// Loop through all the waiting parents to see if one needs to be woken up
 	while(p) {
-		if(p->pid == current->ppid && (p->waiting_for_child_pid == 0 || p->waiting_for_child_pid == current->pid)) {
-			p->state = PROCESS_STATE_READY;
+		if(p->waiting_for_child_pid == current->pid || (p->pid == current->ppid && p->waiting_for_child_pid == 0)) {
 			p->waiting_for_child_pid = 0;
 			list_remove(&p->node);
-			list_push_tail(&ready_list, &p->node);
+			process_ready(p);
 			break;
 		}
 		p = (struct process *) (&p->node)->next;
@@ -368,8 +1173,7 @@ void process_wakeup_all(struct list *q)
 {
 	struct process *p;
 	while((p = (struct process *) list_pop_head(q))) {
-		p->state = PROCESS_STATE_READY;
-		list_push_tail(&ready_list, &p->node);
+		process_ready(p);
 	}
 }
 
@@ -389,53 +1193,193 @@ void process_dump(struct process *p)
 	printf("eip: %x\n", s->eip);
 }
 
+/*
+Return the lowest free descriptor, growing the table if it is full,
+or -1 if the table cannot grow.  The slot is not claimed until the
+caller stores an object with process_object_set.
+*/
+
 int process_available_fd(struct process *p)
 {
-	struct kobject **fdtable = current->ktable;
+	struct process_space *s = p->space;
+	int words = s->ktable_size / 32;
 	int i;
-	for(i = 0; i < PROCESS_MAX_OBJECTS; i++) {
-		if(fdtable[i] == 0)
-			return i;
+
+	for(i = s->kfirst; i < words; i++) {
+		if(~s->kbitmap[i]) {
+			s->kfirst = i;
+			return i * 32 + __builtin_ctz(~s->kbitmap[i]);
+		}
 	}
-	return -1;
+
+	s->kfirst = words;
+	if(process_object_grow(s, s->ktable_size + 1) < 0)
+		return -1;
+	return words * 32;
 }
 
+/* Return the highest descriptor in use, or -1 if there are none. */
+
 int process_object_max(struct process *p)
 {
-	struct kobject **fdtable = current->ktable;
+	struct process_space *s = p->space;
 	int i;
-	// Because of 0-indexing, PROCESS_MAX_OBJECTS is the size and
-	// therefor 1 offset, don't look for 0 there.
-	for(i = PROCESS_MAX_OBJECTS - 1; i > -1; i--) {
-		if(fdtable[i] != 0)
-			return i;
+
+	for(i = s->ktable_size / 32 - 1; i >= 0; i--) {
+		if(s->kbitmap[i])
+			return i * 32 + 31 - __builtin_clz(s->kbitmap[i]);
 	}
 	return -1;
 }
 
-void process_make_dead(struct process *dead)
+void process_make_dead(struct process *dead);
+
+static void process_make_dead_one(struct process *dead)
 {
-	int i;
-	for(i = 0; i < PROCESS_MAX_PID; i++) {
-		if(process_table[i] && process_table[i]->ppid == dead->pid) {
-			process_make_dead(process_table[i]);
+	struct list_node *n, *next;
+	struct process *c;
+
+	for(n = dead->children.head; n; n = next) {
+		next = n->next;
+		c = process_from_sibling(n);
+		if(c->state != PROCESS_STATE_GRAVE) {
+			process_make_dead(c);
 		}
 	}
 	dead->exitcode = 0;
 	dead->exitreason = PROCESS_EXIT_KILLED;
+	clock_timer_cancel(&dead->timer);
 	if(dead == current) {
 		process_switch(PROCESS_STATE_GRAVE);
+	} else if(dead->state == PROCESS_STATE_RUNNING) {
+		/* Running on another CPU: it will notice on the way back to user mode. */
+		dead->killed = 1;
+		cpu_wake(&cpus[dead->cpu]);
 	} else {
-		list_remove(&dead->node);
-		list_push_tail(&grave_list, &dead->node);
+		if(dead->state == PROCESS_STATE_READY) {
+			process_ready_remove(dead);
+		} else {
+			list_remove(&dead->node);
+		}
+		dead->state = PROCESS_STATE_GRAVE;
+		process_bury(dead);
 	}
 }
 
+/*
+Kill every thread sharing the address space of p, other than p
+and the current process.  No one is left to join them, so they are
+detached, and those that have already exited are deleted.
+Returns true if the current process is one of the threads.
+*/
+
+static int process_kill_group(struct process *p)
+{
+	struct process *q;
+	int i, self = 0;
+
+	if(!p->space || p->space->refcount < 2)
+		return 0;
+
+	for(i = 0; i < PROCESS_MAX_PID; i++) {
+		q = process_table[i];
+		if(!q || q == p || q->space != p->space)
+			continue;
+		if(q == current) {
+			self = 1;
+		} else if(q->state == PROCESS_STATE_GRAVE) {
+			list_remove(&q->node);
+			process_delete(q);
+		} else {
+			q->detached = 1;
+			process_make_dead_one(q);
+		}
+	}
+
+	return self;
+}
+
+void process_make_dead(struct process *dead)
+{
+	int self = process_kill_group(dead);
+
+	process_make_dead_one(dead);
+
+	if(self) {
+		current->detached = 1;
+		process_make_dead_one(current);
+	}
+}
+
+/* Kill the other threads of the current process, as on exit or exec. */
+
+void process_kill_threads()
+{
+	process_kill_group(current);
+}
+
+/*
+Wait for another thread of the current process to exit,
+then delete it and return its exit code.
+*/
+
+int process_join(uint32_t pid, int *exitcode)
+{
+	struct process *p;
+
+	while(1) {
+		p = pid < PROCESS_MAX_PID ? process_table[pid] : 0;
+		if(!p || p == current || p->space != current->space || p->ppid || p->detached)
+			return KERROR_NOT_FOUND;
+		if(p->state == PROCESS_STATE_GRAVE)
+			break;
+		current->waiting_for_child_pid = pid;
+		process_wait(&grave_watcher_list);
+	}
+
+	*exitcode = p->exitcode;
+	list_remove(&p->node);
+	process_delete(p);
+
+	return 0;
+}
+
+/*
+Set the base priority level of a process (or the current
+process, if pid is zero.)  Higher values are less urgent.
+*/
+
+int process_set_nice(uint32_t pid, int nice)
+{
+	struct process *p;
+
+	if(nice < 0 || nice >= PROCESS_PRIORITY_LEVELS)
+		return KERROR_INVALID_REQUEST;
+
+	if(pid == 0) {
+		p = current;
+	} else if(pid < PROCESS_MAX_PID) {
+		p = process_table[pid];
+	} else {
+		p = 0;
+	}
+
+	if(!p)
+		return KERROR_NOT_FOUND;
+
+	p->nice = nice;
+	if(p->priority < nice)
+		p->priority = nice;
+
+	return 0;
+}
+
 int process_kill(uint32_t pid)
 {
 	if(pid > 0 && pid <= PROCESS_MAX_PID) {
 		struct process *dead = process_table[pid];
-		if(dead) {
+		/* Kernel threads may be in the middle of work for others. */
+		if(dead && !dead->kthread_entry) {
 			printf("process killed\n");
 			process_make_dead(dead);
 			return 0;
@@ -447,10 +1391,20 @@ int process_kill(uint32_t pid)
 	}
 }
 
+/* Return the exited, not yet reaped process with this pid, if any. */
+
+static struct process *process_zombie(uint32_t pid)
+{
+	struct process *p = pid < PROCESS_MAX_PID ? process_table[pid] : 0;
+	if(p && p->state == PROCESS_STATE_GRAVE && p->node.list)
+		return p;
+	return 0;
+}
+
 int process_wait_child(uint32_t pid, struct process_info *info, int timeout)
 {
 	clock_t start, elapsed;
-	uint32_t total;
+	uint32_t total = 0;
 
 	if(!info)
 		return -1;
@@ -458,20 +1412,22 @@ int process_wait_child(uint32_t pid, struct process_info *info, int timeout)
 	start = clock_read();
 
 	do {
-		struct process *p = (struct process *) (grave_list.head);
-		while(p) {
-			struct process *next = (struct process *) p->node.next;
-			if((pid != 0 && p->pid == pid) || (p->ppid == current->pid)) {
-				info->exitcode = p->exitcode;
-				info->exitreason = p->exitreason;
-				info->pid = p->pid;
-				return p->pid;
-			}
-			p = next;
+		struct process *p;
+		if(pid != 0) {
+			p = process_zombie(pid);
+		} else {
+			p = (struct process *) current->zombies.head;
+		}
+		if(p) {
+			info->exitcode = p->exitcode;
+			info->exitreason = p->exitreason;
+			info->pid = p->pid;
+			return p->pid;
 		}
 
 		current->waiting_for_child_pid = pid;
-		process_wait(&grave_watcher_list);
+		if(process_wait_timeout(&grave_watcher_list, timeout < 0 ? -1 : timeout - total))
+			break;
 
 		elapsed = clock_diff(start, clock_read());
 		total = elapsed.millis + elapsed.seconds * 1000;
@@ -482,15 +1438,11 @@ int process_wait_child(uint32_t pid, struct process_info *info, int timeout)
 
 int process_reap(uint32_t pid)
 {
-	struct process *p = (struct process *) (grave_list.head);
-	while(p) {
-		struct process *next = (struct process *) p->node.next;
-		if(p->pid == pid) {
-			list_remove(&p->node);
-			process_delete(p);
-			return 0;
-		}
-		p = next;
+	struct process *p = process_zombie(pid);
+	if(p) {
+		list_remove(&p->node);
+		process_delete(p);
+		return 0;
 	}
 	return 1;
 }
@@ -510,7 +1462,7 @@ void process_pass_arguments(struct process *p, int argc, char **argv)
 	char *esp = (char *) PROCESS_STACK_INIT;
 
 	/* Make a local array to keep track of user addresses. */
-	char **addr_of_argv = kmalloc(sizeof(char *) * argc);
+	char **addr_of_argv = kmalloc_tag(sizeof(char *) * argc, MEMORY_TAG_PROCESS);
 
 	/* For each argument, in reverse order: */
 	int i;
@@ -553,9 +1505,25 @@ void process_pass_arguments(struct process *p, int argc, char **argv)
 
 int process_stats(int pid, struct process_stats *s)
 {
+	int i;
+
 	if(pid > PROCESS_MAX_PID || !process_table[pid]) {
 		return 1;
 	}
-	*s = process_table[pid]->stats;
+	struct process *p = process_table[pid];
+	*s = p->stats;
+	if(p->space) {
+		s->vm_data_size = p->space->vm_data_size;
+		s->vm_stack_size = p->space->vm_stack_size;
+	}
+	s->resident_pages = pagetable_resident(p->pagetable, PROCESS_ENTRY_POINT, 0 - PROCESS_ENTRY_POINT);
+	s->nice = p->nice;
+	s->user_time = clock_divide(p->user_nanos, 1000000, 0);
+	s->kernel_time = clock_divide(p->kernel_nanos, 1000000, 0);
+	s->run_time = s->user_time + s->kernel_time;
+	s->wait_time = clock_divide(p->wait_nanos, 1000000, 0);
+	for(i = 0; i < MAX_SYSCALL; i++) {
+		s->syscall_time[i] = clock_divide(p->syscall_nanos[i], 1000, 0);
+	}
 	return 0;
 }
@@ -14,6 +14,8 @@ See the file LICENSE for details.
 #include "kobject.h"
 #include "x86.h"
 #include "fs.h"
+#include "clock.h"
+#include "cpu.h"
 
 #define PROCESS_STATE_CRADLE  0
 #define PROCESS_STATE_READY   1
@@ -21,12 +23,56 @@ See the file LICENSE for details.
 #define PROCESS_STATE_BLOCKED 3
 #define PROCESS_STATE_GRAVE   4
 
-#define PROCESS_MAX_OBJECTS 32
+/*
+The object table starts with PROCESS_MIN_OBJECTS slots,
+and doubles as needed up to PROCESS_MAX_OBJECTS.
+*/
+
+#define PROCESS_MIN_OBJECTS 32
+#define PROCESS_MAX_OBJECTS 1024
 #define PROCESS_MAX_PID 1024
 
+/*
+Heap growth of at least this much at once is mapped
+with 4MB pages where the region allows it.
+*/
+
+#define PROCESS_LARGE_PAGE_SIZE 0x400000
+
+/*
+Ready processes wait in one of several queues, 0 being the most
+urgent.  A process that uses up its quantum drops a level, and its
+quantum doubles with each level.  Waiting for user input (or nice)
+resets it to its base level, and every so often everyone is
+boosted back to their base level so that nothing starves.
+*/
+
+#define PROCESS_PRIORITY_LEVELS 4
+#define PROCESS_QUANTUM_MILLIS 10
+#define PROCESS_BOOST_MILLIS 1000
+
 #define PROCESS_EXIT_NORMAL   0
 #define PROCESS_EXIT_KILLED   1
 
+/*
+The threads of a program share one address space and one table
+of open objects, which go away along with the last of them.
+*/
+
+struct elf_image;
+struct poll_call;
+
+struct process_space {
+	int refcount;
+	uint32_t vm_data_size;
+	uint32_t vm_stack_size;
+	struct elf_image *image;
+	struct kobject **ktable;
+	uint32_t *kbitmap;
+	int ktable_size;
+	int kfirst;
+};
+
 struct process {
 	struct list_node node;
 	int state;
@@ -36,18 +82,40 @@ struct process {
 	char *kstack;
 	char *kstack_top;
 	char *kstack_ptr;
-	struct kobject *ktable[PROCESS_MAX_OBJECTS];
+	struct process_space *space;
 	struct process_stats stats;
 	uint32_t pid;
 	uint32_t ppid;
-	uint32_t vm_data_size;
-	uint32_t vm_stack_size;
 	uint32_t waiting_for_child_pid;
+	struct process *parent;
+	struct list children;
+	struct list_node sibling;
+	struct list zombies;
+	int quantum;
+	int priority;
+	int nice;
+	uint64_t ready_since;
+	uint64_t mark;
+	uint64_t user_nanos;
+	uint64_t kernel_nanos;
+	uint64_t wait_nanos;
+	uint64_t syscall_nanos[MAX_SYSCALL];
+	struct clock_timer timer;
+	int cpu;
+	int kernel_depth;
+	int killed;
+	int detached;
+	uint32_t futex_key;
+	struct poll_call *poll;
+	void (*kthread_entry)(void *arg);
+	void *kthread_arg;
 };
 
 void process_init();
 
 struct process *process_create();
+struct process *process_create_kernel(void (*entry)(void *arg), void *arg);
+struct process *process_create_thread(struct process *parent, unsigned entry_point, unsigned stack);
 void process_delete(struct process *p);
 void process_launch(struct process *p);
 void process_pass_arguments(struct process *p, int argc, char **argv);
@@ -59,17 +127,33 @@ void process_kstack_reset(struct process *p, unsigned entry_point);
 void process_kstack_copy(struct process *parent, struct process *child);
 
 int process_data_size_set(struct process *p, unsigned size);
+int process_data_size_reserve(struct process *p, unsigned size);
 int process_stack_size_set(struct process *p, unsigned size);
 
 int process_available_fd(struct process *p);
 int process_object_max(struct process *p);
+int process_object_reserve(struct process *p, int fd);
+void process_object_set(struct process *p, int fd, struct kobject *k);
 
 void process_yield();
 void process_preempt();
+void process_exit_if_killed();
+int  process_wait_interactive(struct list *q, int millis);
+int  process_wait_timeout(struct list *q, int millis);
+void process_unblock(struct process *p);
+int process_set_nice(uint32_t pid, int nice);
+void process_tick();
+void process_idle_stats(uint32_t *idle_millis, uint32_t *utilization);
+void process_enter_kernel();
+void process_leave_kernel();
 void process_exit(int code);
+void process_kill_threads();
+int  process_join(uint32_t pid, int *exitcode);
 void process_dump(struct process *p);
 
 void process_wait(struct list *q);
+void process_wait_locked(struct list *q, struct spinlock *lock);
+void process_cpu_start();
 void process_wakeup(struct list *q);
 void process_wakeup_parent(struct list *q);
 void process_wakeup_all(struct list *q);
@@ -81,6 +165,7 @@ int process_reap(uint32_t pid);
 
 int process_stats(int pid, struct process_stats *stat);
 
-extern struct process *current;
+/* The process running on this CPU, or null if it is idle. */
+#define current (cpu_self()->process)
 
 #endif
@@ -0,0 +1,158 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+/*
+A shared memory segment is a set of physical pages that is
+mapped at the same virtual address in every process holding
+the segment, so that pointers into it mean the same thing
+everywhere.  Addresses are handed out first-fit from the
+range [PROCESS_SHMEM_START,PROCESS_SHMEM_END) and the pages
+are released when the last reference is dropped.  The pages
+are mapped without the allocation bit, so pagetable_delete
+and pagetable_duplicate leave them alone.
+*/
+
+#include "shmem.h"
+#include "kmalloc.h"
+#include "page.h"
+#include "pagetable.h"
+#include "memorylayout.h"
+#include "string.h"
+
+struct shmem {
+	uint32_t vaddr;
+	int npages;
+	void **pages;
+	int refcount;
+	struct shmem *next;
+};
+
+static struct shmem *shmem_list = 0;
+
+static uint32_t shmem_vaddr_alloc(struct shmem *s)
+{
+	struct shmem **prev = &shmem_list;
+	uint32_t start = PROCESS_SHMEM_START;
+	uint32_t length = s->npages * PAGE_SIZE;
+
+	while(*prev) {
+		if((*prev)->vaddr - start >= length) break;
+		start = (*prev)->vaddr + (*prev)->npages * PAGE_SIZE;
+		prev = &(*prev)->next;
+	}
+
+	if(PROCESS_SHMEM_END - start < length) return 0;
+
+	s->vaddr = start;
+	s->next = *prev;
+	*prev = s;
+
+	return start;
+}
+
+static void shmem_vaddr_free(struct shmem *s)
+{
+	struct shmem **prev = &shmem_list;
+	while(*prev) {
+		if(*prev == s) {
+			*prev = s->next;
+			return;
+		}
+		prev = &(*prev)->next;
+	}
+}
+
+struct shmem *shmem_create(int size)
+{
+	int i;
+
+	if(size <= 0 || size > PROCESS_SHMEM_END - PROCESS_SHMEM_START) return 0;
+
+	struct shmem *s = kmalloc(sizeof(*s));
+	if(!s) return 0;
+
+	s->npages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+	s->refcount = 1;
+	s->pages = kmalloc(sizeof(void *) * s->npages);
+	if(!s->pages) {
+		kfree(s);
+		return 0;
+	}
+	memset(s->pages, 0, sizeof(void *) * s->npages);
+
+	if(!shmem_vaddr_alloc(s)) {
+		kfree(s->pages);
+		kfree(s);
+		return 0;
+	}
+
+	for(i = 0; i < s->npages; i++) {
+		s->pages[i] = page_alloc_tag(1, MEMORY_TAG_USER);
+		if(!s->pages[i]) {
+			shmem_delete(s);
+			return 0;
+		}
+	}
+
+	return s;
+}
+
+struct shmem *shmem_addref(struct shmem *s)
+{
+	s->refcount++;
+	return s;
+}
+
+void shmem_delete(struct shmem *s)
+{
+	int i;
+
+	if(!s) return;
+
+	s->refcount--;
+	if(s->refcount == 0) {
+		for(i = 0; i < s->npages; i++) {
+			if(s->pages[i])
+				page_free(s->pages[i]);
+		}
+		shmem_vaddr_free(s);
+		kfree(s->pages);
+		kfree(s);
+	}
+}
+
+int shmem_map(struct shmem *s, struct pagetable *p)
+{
+	int i;
+	for(i = 0; i < s->npages; i++) {
+		uint32_t vaddr = s->vaddr + i * PAGE_SIZE;
+		if(!pagetable_map(p, vaddr, (unsigned) s->pages[i], PAGE_FLAG_USER | PAGE_FLAG_READWRITE)) {
+			while(--i >= 0) {
+				pagetable_unmap(p, s->vaddr + i * PAGE_SIZE);
+			}
+			return 0;
+		}
+	}
+	return 1;
+}
+
+void shmem_unmap(struct shmem *s, struct pagetable *p)
+{
+	int i;
+	for(i = 0; i < s->npages; i++) {
+		pagetable_unmap(p, s->vaddr + i * PAGE_SIZE);
+	}
+}
+
+uint32_t shmem_address(struct shmem *s)
+{
+	return s->vaddr;
+}
+
+int shmem_size(struct shmem *s)
+{
+	return s->npages * PAGE_SIZE;
+}
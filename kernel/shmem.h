@@ -0,0 +1,24 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#ifndef SHMEM_H
+#define SHMEM_H
+
+#include "kernel/types.h"
+
+struct pagetable;
+
+struct shmem *shmem_create(int size);
+struct shmem *shmem_addref(struct shmem *s);
+void shmem_delete(struct shmem *s);
+
+int shmem_map(struct shmem *s, struct pagetable *p);
+void shmem_unmap(struct shmem *s, struct pagetable *p);
+
+uint32_t shmem_address(struct shmem *s);
+int shmem_size(struct shmem *s);
+
+#endif
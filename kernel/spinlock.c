@@ -0,0 +1,117 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#include "spinlock.h"
+#include "interrupt.h"
+#include "cpu.h"
+#include "pagetable.h"
+
+void spinlock_init(struct spinlock *l)
+{
+	l->locked = 0;
+}
+
+void spinlock_acquire(struct spinlock *l)
+{
+	while(__sync_lock_test_and_set(&l->locked, 1)) {
+		while(l->locked) {
+			asm volatile ("pause");
+		}
+	}
+}
+
+void spinlock_release(struct spinlock *l)
+{
+	__sync_lock_release(&l->locked);
+}
+
+static struct spinlock kernel_spinlock = SPINLOCK_INIT;
+static volatile int kernel_lock_owner = -1;
+static int kernel_lock_count = 0;
+
+/*
+While waiting for the kernel lock, answer any TLB shootdown,
+since the holder may be waiting for exactly that.
+*/
+
+static void kernel_lock_spin(struct cpu *c)
+{
+	while(__sync_lock_test_and_set(&kernel_spinlock.locked, 1)) {
+		while(kernel_spinlock.locked) {
+			if(c->tlb_flush) {
+				pagetable_refresh();
+				c->tlb_flush = 0;
+			}
+			asm volatile ("pause");
+		}
+	}
+}
+
+void kernel_lock_acquire()
+{
+	int enabled = interrupt_block_save();
+	struct cpu *c = cpu_self();
+	int id = c->id;
+
+	if(kernel_lock_owner == id) {
+		kernel_lock_count++;
+	} else {
+		kernel_lock_spin(c);
+		kernel_lock_owner = id;
+		kernel_lock_count = 1;
+	}
+
+	interrupt_restore(enabled);
+}
+
+void kernel_lock_release()
+{
+	int enabled = interrupt_block_save();
+
+	if(--kernel_lock_count == 0) {
+		kernel_lock_owner = -1;
+		spinlock_release(&kernel_spinlock);
+	}
+
+	interrupt_restore(enabled);
+}
+
+/*
+Return how deeply this CPU holds the kernel lock, or zero
+if some other CPU (or none) holds it.
+*/
+
+int kernel_lock_depth()
+{
+	return kernel_lock_owner == cpu_self()->id ? kernel_lock_count : 0;
+}
+
+/*
+Used by the scheduler to hand the lock from one context to
+the next: the incoming process resumes at whatever depth it
+held when it was switched out, and zero releases the lock.
+*/
+
+void kernel_lock_set_depth(int depth)
+{
+	int enabled = interrupt_block_save();
+	struct cpu *c = cpu_self();
+	int id = c->id;
+
+	if(depth > 0) {
+		if(kernel_lock_owner != id) {
+			kernel_lock_spin(c);
+			kernel_lock_owner = id;
+		}
+		kernel_lock_count = depth;
+	} else if(kernel_lock_owner == id) {
+		kernel_lock_owner = -1;
+		kernel_lock_count = 0;
+		spinlock_release(&kernel_spinlock);
+	}
+
+	interrupt_restore(enabled);
+}
@@ -0,0 +1,39 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "kernel/types.h"
+
+/*
+A spinlock is held only briefly, and never across a process switch.
+It does not block interrupts: code that shares a spinlock with an
+interrupt handler must block interrupts before taking it.
+*/
+
+struct spinlock {
+	volatile uint32_t locked;
+};
+
+#define SPINLOCK_INIT {0}
+
+void spinlock_init(struct spinlock *l);
+void spinlock_acquire(struct spinlock *l);
+void spinlock_release(struct spinlock *l);
+
+/*
+The kernel lock serializes everything that is not yet covered by
+a finer lock.  It is taken on every entry from user mode, and may
+be taken again by the same CPU, so interrupts in the kernel nest.
+*/
+
+void kernel_lock_acquire();
+void kernel_lock_release();
+int  kernel_lock_depth();
+void kernel_lock_set_depth(int depth);
+
+#endif
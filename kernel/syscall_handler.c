@@ -6,6 +6,7 @@ See the file LICENSE for details.
 
 #include "kernel/syscall.h"
 #include "kernel/gfxstream.h"
+#include "kernel/ring.h"
 #include "syscall_handler.h"
 #include "console.h"
 #include "keyboard.h"
@@ -28,6 +29,12 @@ See the file LICENSE for details.
 #include "window.h"
 #include "is_valid.h"
 #include "bcache.h"
+#include "memtrace.h"
+#include "spinlock.h"
+#include "futex.h"
+#include "poll.h"
+#include "systrace.h"
+#include "device.h"
 
 /*
 syscall_handler() is responsible for decoding system calls
@@ -63,8 +70,11 @@ int sys_process_yield()
 	return 0;
 }
 
+/* Exiting ends every thread of the process. */
+
 int sys_process_exit(int status)
 {
+	process_kill_threads();
 	process_exit(status);
 	return 0;
 }
@@ -103,7 +113,7 @@ int sys_process_run( int fd, int argc, const char **argv)
 {
 	if(!is_valid_object_type(fd,KOBJECT_FILE)) return KERROR_INVALID_OBJECT;
 
-	struct kobject *k = current->ktable[fd];
+	struct kobject *k = current->space->ktable[fd];
 
 	/* Copy argv into kernel memory. */
 	char **copy_argv = argv_copy(argc, argv);
@@ -151,7 +161,8 @@ int sys_process_run( int fd, int argc, const char **argv)
 int sys_process_wrun( int fd, int argc, const char **argv, int *fds, int fd_len)
 {
 	if(!is_valid_object_type(fd,KOBJECT_FILE)) return KERROR_INVALID_OBJECT;
-	struct kobject *k = current->ktable[fd];
+	if(fd_len < 0 || fd_len > PROCESS_MAX_OBJECTS || !is_valid_pointer(fds, sizeof(*fds)*fd_len)) return KERROR_INVALID_ADDRESS;
+	struct kobject *k = current->space->ktable[fd];
 
 	/* Copy argv array into kernel memory. */
 	char **copy_argv = argv_copy(argc, argv);
@@ -199,13 +210,16 @@ int sys_process_wrun( int fd, int argc, const char **argv, int *fds, int fd_len)
 int sys_process_exec( int fd, int argc, const char **argv)
 {
 	if(!is_valid_object_type(fd,KOBJECT_FILE)) return KERROR_INVALID_OBJECT;
-	struct kobject *k = current->ktable[fd];
+	struct kobject *k = current->space->ktable[fd];
 
 	addr_t entry;
 
 	/* Duplicate the arguments into kernel space */
 	char **copy_argv = argv_copy(argc, argv);
 
+	/* The other threads cannot survive the old image. */
+	process_kill_threads();
+
 	/* Attempt to load the program image into this process. */
 	int r = elf_load(current, k->data.file, &entry);
 
@@ -245,6 +259,9 @@ int sys_process_fork()
 	p->ppid = current->pid;
 	pagetable_delete(p->pagetable);
 	p->pagetable = pagetable_duplicate(current->pagetable);
+	p->space->vm_data_size = current->space->vm_data_size;
+	p->space->vm_stack_size = current->space->vm_stack_size;
+	p->space->image = elf_image_addref(current->space->image);
 	process_inherit(current, p);
 	process_kstack_copy(current, p);
 	process_launch(p);
@@ -289,18 +306,85 @@ int sys_process_stats(struct process_stats *s, int pid)
 	return process_stats(pid, s);
 }
 
+/*
+Like sbrk(), return the previous end of the heap, or -1 on failure.
+New heap pages are not allocated until they are touched.
+*/
+
 int sys_process_heap(int delta)
 {
-	process_data_size_set(current, current->vm_data_size + delta);
-	return PROCESS_ENTRY_POINT + current->vm_data_size;
+	uint32_t old_end = PROCESS_ENTRY_POINT + current->space->vm_data_size;
+
+	if(delta < 0 && -delta > current->space->vm_data_size) return -1;
+	if(process_data_size_reserve(current, current->space->vm_data_size + delta) < 0) return -1;
+
+	return old_end;
+}
+
+int sys_process_nice(int pid, int nice)
+{
+	return process_set_nice(pid, nice);
+}
+
+/*
+Start a thread at entry in this address space.  The caller
+prepares the stack, so that entry sees its arguments in place.
+*/
+
+int sys_thread_create(uint32_t entry, uint32_t stack)
+{
+	if(entry < PROCESS_ENTRY_POINT || stack < PROCESS_ENTRY_POINT) return KERROR_INVALID_ADDRESS;
+
+	struct process *p = process_create_thread(current, entry, stack);
+	if(!p) return KERROR_OUT_OF_MEMORY;
+
+	process_launch(p);
+	return p->pid;
+}
+
+/*
+The first thread of a process is the one its parent waits for,
+so when it leaves, the whole process goes with it.
+*/
+
+int sys_thread_exit(int status)
+{
+	if(current->ppid)
+		process_kill_threads();
+	process_exit(status);
+	return 0;
+}
+
+int sys_thread_join(int pid, int *status)
+{
+	int exitcode;
+	if(status && !is_valid_pointer(status, sizeof(*status))) return KERROR_INVALID_ADDRESS;
+
+	int r = process_join(pid, &exitcode);
+	if(r < 0) return r;
+
+	if(status) *status = exitcode;
+	return 0;
+}
+
+int sys_futex_wait(uint32_t *addr, uint32_t expected, int timeout)
+{
+	if(!is_valid_pointer(addr, sizeof(*addr))) return KERROR_INVALID_ADDRESS;
+	return futex_wait(addr, expected, timeout);
+}
+
+int sys_futex_wake(uint32_t *addr, int count)
+{
+	if(!is_valid_pointer(addr, sizeof(*addr))) return KERROR_INVALID_ADDRESS;
+	return futex_wake(addr, count);
 }
 
 int sys_object_list( int fd, char *buffer, int length)
 {
 	if(!is_valid_object(fd)) return KERROR_INVALID_OBJECT;
 	if(!is_valid_pointer(buffer,length)) return KERROR_INVALID_ADDRESS;
-	if(kobject_get_type(current->ktable[fd])!=KOBJECT_DIR) return KERROR_NOT_A_DIRECTORY;
-	return kobject_list(current->ktable[fd],buffer,length);
+	if(kobject_get_type(current->space->ktable[fd])!=KOBJECT_DIR) return KERROR_NOT_A_DIRECTORY;
+	return kobject_list(current->space->ktable[fd],buffer,length);
 }
 
 int sys_open_file( int fd, const char *path, int mode, kernel_flags_t flags)
@@ -312,10 +396,15 @@ int sys_open_file( int fd, const char *path, int mode, kernel_flags_t flags)
 	if(newfd<0) return KERROR_OUT_OF_OBJECTS;
 
 	struct kobject *newobj;
-	int result = kobject_lookup(current->ktable[fd],path,&newobj);
+	int result = kobject_lookup(current->space->ktable[fd],path,&newobj);
+
+	if(result==KERROR_NOT_FOUND && (flags&KERNEL_FLAGS_CREATE)) {
+		newobj = kobject_create_file_from_dir(current->space->ktable[fd],path);
+		result = newobj ? 0 : KERROR_NOT_FOUND;
+	}
 
 	if(result>=0) {
-		current->ktable[newfd] = newobj;
+		process_object_set(current, newfd, newobj);
 		return newfd;
 	} else {
 		return result;
@@ -334,18 +423,18 @@ int sys_open_dir( int fd, const char *path, kernel_flags_t flags )
 	int result;
 
 	if(flags&KERNEL_FLAGS_CREATE) {
-		newobj = kobject_create_dir_from_dir( current->ktable[fd], path );
+		newobj = kobject_create_dir_from_dir( current->space->ktable[fd], path );
 		if(newobj) {
 			result = 0;
 		} else {
 			result = KERROR_NOT_FOUND;
 		}
 	} else {
-		result = kobject_lookup( current->ktable[fd], path, &newobj );
+		result = kobject_lookup( current->space->ktable[fd], path, &newobj );
 	}
 
 	if(result>=0) {
-		current->ktable[newfd] = newobj;
+		process_object_set(current, newfd, newobj);
 		return newfd;
 	} else {
 		return result;
@@ -359,7 +448,7 @@ int sys_open_console(int wd)
 	int fd = process_available_fd(current);
 	if(fd<0) return KERROR_OUT_OF_OBJECTS;
 
-	current->ktable[fd] = kobject_create_console_from_window(current->ktable[wd]);
+	process_object_set(current, fd, kobject_create_console_from_window(current->space->ktable[wd]));
 	return fd;
 }
 
@@ -368,7 +457,7 @@ int sys_open_window(int wd, int x, int y, int w, int h)
 {
 	if(!is_valid_object_type(wd,KOBJECT_WINDOW)) return KERROR_INVALID_OBJECT;
 
-	struct kobject *k = current->ktable[wd];
+	struct kobject *k = current->space->ktable[wd];
 
 	int fd = process_available_fd(current);
 	if(fd<0) return KERROR_OUT_OF_OBJECTS;
@@ -379,30 +468,89 @@ int sys_open_window(int wd, int x, int y, int w, int h)
 		return KERROR_INVALID_REQUEST;
 	}
 
-	current->ktable[fd] = k;
+	process_object_set(current, fd, k);
 
 	return fd;
 }
 
-int sys_open_pipe()
+int sys_open_pipe(int size)
 {
+	if(size < 0 || size > PIPE_MAX_PAGES * PAGE_SIZE) return KERROR_INVALID_REQUEST;
 	int fd = process_available_fd(current);
 	if(fd < 0) {
 		return KERROR_NOT_FOUND;
 	}
-	struct pipe *p = pipe_create();
+	struct pipe *p = pipe_create(size);
 	if(!p) {
+		return KERROR_OUT_OF_MEMORY;
+	}
+	process_object_set(current, fd, kobject_create_pipe(p));
+	return fd;
+}
+
+int sys_open_shmem(int size)
+{
+	int fd = process_available_fd(current);
+	if(fd < 0) {
 		return KERROR_NOT_FOUND;
 	}
-	current->ktable[fd] = kobject_create_pipe(p);
+	struct shmem *s = shmem_create(size);
+	if(!s) {
+		return KERROR_OUT_OF_MEMORY;
+	}
+	struct kobject *k = kobject_create_shmem(s);
+	if(kobject_map(k, current->pagetable) < 0) {
+		kobject_close(k);
+		return KERROR_OUT_OF_MEMORY;
+	}
+	process_object_set(current, fd, k);
 	return fd;
 }
 
+/*
+Open the system call trace ring as a device.  Only this device
+is offered, since the others include the raw disks, which would
+let any process read and write around the filesystem.
+*/
+
+int sys_open_systrace()
+{
+	int fd = process_available_fd(current);
+	if(fd < 0) return KERROR_OUT_OF_OBJECTS;
+
+	struct device *d = device_open("systrace", 0);
+	if(!d) return KERROR_NOT_FOUND;
+
+	process_object_set(current, fd, kobject_create_device(d));
+	return fd;
+}
+
+/*
+Both objects are held for the duration, since a pipe at either
+end may block, and another thread could close the fd meanwhile.
+*/
+
+int sys_object_transfer(int src, int dst, int length)
+{
+	if(!is_valid_object(src) || !is_valid_object(dst)) return KERROR_INVALID_OBJECT;
+	if(length < 0) return KERROR_INVALID_REQUEST;
+
+	struct kobject *s = kobject_addref(current->space->ktable[src]);
+	struct kobject *d = kobject_addref(current->space->ktable[dst]);
+
+	int result = kobject_transfer(s, d, length);
+
+	kobject_release(s);
+	kobject_release(d);
+
+	return result;
+}
+
 int sys_object_type(int fd)
 {
 	if(!is_valid_object(fd)) return KERROR_INVALID_OBJECT;
 
-	int fd_type = kobject_get_type(current->ktable[fd]);
+	int fd_type = kobject_get_type(current->space->ktable[fd]);
 	if(!fd_type)
 		return 0;
 	return fd_type;
@@ -411,16 +559,18 @@ int sys_object_type(int fd)
 int sys_object_copy( int src, int dst )
 {
 	if(!is_valid_object(src)) return KERROR_INVALID_OBJECT;
-	if(dst>PROCESS_MAX_OBJECTS) return KERROR_INVALID_OBJECT;
+	if(dst>=PROCESS_MAX_OBJECTS) return KERROR_INVALID_OBJECT;
 
 	if(dst < 0) {
 		dst = process_available_fd(current);
 		if(dst<0) return KERROR_NOT_FOUND;
+	} else if(process_object_reserve(current, dst) < 0) {
+		return KERROR_OUT_OF_MEMORY;
 	}
 
 	sys_object_close(dst);
 
-	current->ktable[dst] = kobject_copy(current->ktable[src]);
+	process_object_set(current, dst, kobject_copy(current->space->ktable[src]));
 
 	return src;
 }
@@ -430,7 +580,7 @@ int sys_object_read(int fd, void *data, int length, kernel_io_flags_t flags )
 	if(!is_valid_object(fd)) return KERROR_INVALID_OBJECT;
 	if(!is_valid_pointer(data,length)) return KERROR_INVALID_ADDRESS;
 
-	struct kobject *p = current->ktable[fd];
+	struct kobject *p = current->space->ktable[fd];
 	return kobject_read(p, data, length, flags);
 }
 
@@ -439,7 +589,7 @@ int sys_object_write(int fd, void *data, int length, kernel_io_flags_t flags )
 	if(!is_valid_object(fd)) return KERROR_INVALID_OBJECT;
 	if(!is_valid_pointer(data,length)) return KERROR_INVALID_ADDRESS;
 
-	struct kobject *p = current->ktable[fd];
+	struct kobject *p = current->space->ktable[fd];
 	return kobject_write(p, data, length, flags);
 }
 
@@ -455,30 +605,52 @@ int sys_object_remove( int fd, const char *name )
 {
 	if(!is_valid_object(fd)) return KERROR_INVALID_OBJECT;
 	if(!is_valid_path(name)) return KERROR_INVALID_PATH;
-	return kobject_remove( current->ktable[fd], name );
+	return kobject_remove( current->space->ktable[fd], name );
 }
 
 int sys_object_close(int fd)
 {
 	if(!is_valid_object(fd)) return KERROR_INVALID_OBJECT;
 
-	struct kobject *p = current->ktable[fd];
+	struct kobject *p = current->space->ktable[fd];
+	process_object_set(current, fd, 0);
+
+	/* Keep memory objects mapped while any other descriptor still refers to them. */
+	if(kobject_address(p)) {
+		int i;
+		int max = process_object_max(current);
+		for(i = 0; i <= max; i++) {
+			struct kobject *q = current->space->ktable[i];
+			if(q && q->type == p->type && q->data.shmem == p->data.shmem) break;
+		}
+		if(i > max) kobject_unmap(p, current->pagetable);
+	}
+
 	kobject_close(p);
-	current->ktable[fd] = 0;
 	return 0;
 }
 
+/*
+Return the address at which a memory object is mapped, or zero.
+*/
+
+int sys_object_address(int fd)
+{
+	if(!is_valid_object(fd)) return 0;
+	return kobject_address(current->space->ktable[fd]);
+}
+
 int sys_object_set_tag(int fd, char *tag)
 {
 	if(!is_valid_object(fd)) return KERROR_INVALID_OBJECT;
-	kobject_set_tag(current->ktable[fd], tag);
+	kobject_set_tag(current->space->ktable[fd], tag);
 	return 0;
 }
 
 int sys_object_get_tag(int fd, char *buffer, int buffer_size)
 {
 	if(!is_valid_object(fd)) return KERROR_INVALID_OBJECT;
-	return kobject_get_tag(current->ktable[fd], buffer, buffer_size);
+	return kobject_get_tag(current->space->ktable[fd], buffer, buffer_size);
 }
 
 int sys_object_size(int fd, int *dims, int n)
@@ -486,23 +658,112 @@ int sys_object_size(int fd, int *dims, int n)
 	if(!is_valid_object(fd)) return KERROR_INVALID_OBJECT;
 	if(!is_valid_pointer(dims,sizeof(*dims)*n)) return KERROR_INVALID_ADDRESS;
 
-	struct kobject *p = current->ktable[fd];
+	struct kobject *p = current->space->ktable[fd];
 	return kobject_size(p, dims, n);
 }
 
+int sys_object_resize(int fd, int size)
+{
+	if(!is_valid_object(fd)) return KERROR_INVALID_OBJECT;
+	return kobject_resize(current->space->ktable[fd], size);
+}
+
 int sys_object_max()
 {
 	int max_fd = process_object_max(current);
 	return max_fd;
 }
 
+/*
+Wait until any of the n objects is ready for the requested events,
+or timeout millis pass (forever, if negative.)
+Returns the number of entries with events ready.
+*/
+
+int sys_object_poll(struct kernel_poll *fds, int n, int timeout)
+{
+	if(n <= 0 || n > PROCESS_MAX_OBJECTS) return KERROR_INVALID_REQUEST;
+	if(!is_valid_pointer(fds,sizeof(*fds)*n)) return KERROR_INVALID_ADDRESS;
+	return poll_objects(fds, n, timeout);
+}
+
+/*
+Carry out one queued ring operation, through the same checks
+as the corresponding individual syscall.
+*/
+
+static int sys_ring_execute(struct kernel_ring_sqe *e)
+{
+	switch (e->opcode) {
+	case KERNEL_RING_NOP:
+		return 0;
+	case KERNEL_RING_READ:
+		return sys_object_read(e->fd, (void *) e->addr, e->length, e->flags);
+	case KERNEL_RING_WRITE:
+		return sys_object_write(e->fd, (void *) e->addr, e->length, e->flags);
+	case KERNEL_RING_OPEN:
+		return sys_open_file(e->fd, (const char *) e->addr, 0, e->flags);
+	case KERNEL_RING_CLOSE:
+		return sys_object_close(e->fd);
+	default:
+		return KERROR_INVALID_REQUEST;
+	}
+}
+
+/*
+Consume every pending entry of the submission ring, posting a
+completion for each, until the ring is empty or the completion
+queue is full.  Returns the number of entries consumed.
+*/
+
+int sys_ring_enter(struct kernel_ring *r)
+{
+	struct kernel_ring_sqe e;
+	struct kernel_ring_cqe *c;
+	uint32_t entries, mask;
+	struct kernel_ring_sqe *sq;
+	struct kernel_ring_cqe *cq;
+	int total = 0;
+
+	if(!is_valid_pointer(r,sizeof(*r))) return KERROR_INVALID_ADDRESS;
+
+	/* Take one snapshot of the layout, so it cannot change after it is checked. */
+	entries = r->entries;
+	sq = r->sq;
+	cq = r->cq;
+
+	if(entries == 0 || entries > KERNEL_RING_MAX_ENTRIES || (entries & (entries - 1))) return KERROR_INVALID_REQUEST;
+	if(!is_valid_pointer(sq,sizeof(*sq)*entries)) return KERROR_INVALID_ADDRESS;
+	if(!is_valid_pointer(cq,sizeof(*cq)*entries)) return KERROR_INVALID_ADDRESS;
+
+	mask = entries - 1;
+
+	while(r->sq_head != r->sq_tail && r->cq_tail - r->cq_head < entries) {
+		e = sq[r->sq_head & mask];
+		r->sq_head++;
+
+		c = &cq[r->cq_tail & mask];
+		c->user_data = e.user_data;
+		c->result = sys_ring_execute(&e);
+		r->cq_tail++;
+
+		total++;
+	}
+
+	return total;
+}
+
 int sys_system_stats(struct system_stats *s)
 {
 	if(!is_valid_pointer(s,sizeof(*s))) return KERROR_INVALID_ADDRESS;
 
-	struct rtc_time t = { 0 };
-	rtc_read(&t);
-	s->time = rtc_time_to_timestamp(&t) - boottime;
+	uint32_t idle_millis, utilization;
+	process_idle_stats(&idle_millis, &utilization);
+
+	s->time = clock_read().seconds;
+	s->idle_time = idle_millis;
+	s->cpu_utilization = utilization;
+	s->cpu_count = cpu_count;
 
 	struct ata_count a = ata_stats();
 	for(int i = 0; i < 4; i++) {
@@ -520,6 +781,38 @@ int sys_bcache_stats(struct bcache_stats * s)
 	return 0;
 }
 
+int sys_memory_stats(struct memory_stats *s)
+{
+	if(!is_valid_pointer(s,sizeof(*s))) return KERROR_INVALID_ADDRESS;
+	page_stats_tagged(s);
+	kmalloc_stats(s);
+	return 0;
+}
+
+/*
+Turn allocation tracing on (1) or off (0), or leave it alone (-1),
+then drain up to n of the oldest trace entries into t.
+*/
+
+int sys_memory_trace(int enable, struct memory_trace *t, int n)
+{
+	if(n < 0 || !is_valid_pointer(t,sizeof(*t)*n)) return KERROR_INVALID_ADDRESS;
+	if(enable >= 0) memtrace_enable(enable);
+	return memtrace_read(t, n);
+}
+
+/*
+Turn system call tracing on (1) or off (0), or leave it alone (-1),
+then copy out the latency counters of the first n system calls.
+*/
+
+int sys_syscall_stats(int enable, struct syscall_stats *s, int n)
+{
+	if(n < 0 || !is_valid_pointer(s,sizeof(*s)*n)) return KERROR_INVALID_ADDRESS;
+	if(enable >= 0) systrace_enable(enable);
+	return systrace_stats(s, n);
+}
+
 int sys_bcache_flush()
 {
 	bcache_flush_all();
@@ -535,6 +828,13 @@ int sys_system_time( uint32_t *tm )
 	return 0;
 }
 
+int sys_system_nanos( uint64_t *ns )
+{
+	if(!is_valid_pointer(ns,sizeof(*ns))) return KERROR_INVALID_ADDRESS;
+	*ns = clock_nanos();
+	return 0;
+}
+
 int sys_system_rtc( struct rtc_time *t )
 {
 	if(!is_valid_pointer(t,sizeof(*t))) return KERROR_INVALID_ADDRESS;
@@ -551,11 +851,35 @@ int sys_device_driver_stats(const char * name, struct device_driver_stats * stat
 	return 0;
 }
 
+static int32_t syscall_dispatch(syscall_t n, uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e);
+
 int32_t syscall_handler(syscall_t n, uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e)
 {
+	int32_t result;
+	uint64_t start = clock_nanos();
+
+	kernel_lock_acquire();
+	process_enter_kernel();
+
 	if((n < MAX_SYSCALL) && current) {
 		current->stats.syscall_count[n]++;
 	}
+
+	result = syscall_dispatch(n, a, b, c, d, e);
+
+	if(n < MAX_SYSCALL) {
+		systrace_record(n, a, b, c, d, e, result, start);
+	}
+
+	process_exit_if_killed();
+	process_leave_kernel();
+	kernel_lock_release();
+
+	return result;
+}
+
+static int32_t syscall_dispatch(syscall_t n, uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e)
+{
 	switch (n) {
 	case SYSCALL_DEBUG:
 		return sys_debug((const char *) a);
@@ -587,6 +911,18 @@ int32_t syscall_handler(syscall_t n, uint32_t a, uint32_t b, uint32_t c, uint32_
 		return sys_process_stats((struct process_stats *) a, b);
 	case SYSCALL_PROCESS_HEAP:
 		return sys_process_heap(a);
+	case SYSCALL_PROCESS_NICE:
+		return sys_process_nice(a, b);
+	case SYSCALL_THREAD_CREATE:
+		return sys_thread_create(a, b);
+	case SYSCALL_THREAD_EXIT:
+		return sys_thread_exit(a);
+	case SYSCALL_THREAD_JOIN:
+		return sys_thread_join(a, (int *) b);
+	case SYSCALL_FUTEX_WAIT:
+		return sys_futex_wait((uint32_t *) a, b, c);
+	case SYSCALL_FUTEX_WAKE:
+		return sys_futex_wake((uint32_t *) a, b);
 	case SYSCALL_OPEN_FILE:
 		return sys_open_file(a, (const char *)b, c, d);
 	case SYSCALL_OPEN_DIR:
@@ -596,11 +932,17 @@ int32_t syscall_handler(syscall_t n, uint32_t a, uint32_t b, uint32_t c, uint32_
 	case SYSCALL_OPEN_CONSOLE:
 		return sys_open_console(a);
 	case SYSCALL_OPEN_PIPE:
-		return sys_open_pipe();
+		return sys_open_pipe(a);
+	case SYSCALL_OPEN_SHMEM:
+		return sys_open_shmem(a);
+	case SYSCALL_OPEN_SYSTRACE:
+		return sys_open_systrace();
 	case SYSCALL_OBJECT_TYPE:
 		return sys_object_type(a);
 	case SYSCALL_OBJECT_COPY:
 		return sys_object_copy(a,b);
+	case SYSCALL_OBJECT_TRANSFER:
+		return sys_object_transfer(a, b, c);
 	case SYSCALL_OBJECT_READ:
 		return sys_object_read(a, (void *) b, c, d );
 	case SYSCALL_OBJECT_LIST:
@@ -619,16 +961,32 @@ int32_t syscall_handler(syscall_t n, uint32_t a, uint32_t b, uint32_t c, uint32_
 		return sys_object_get_tag(a, (char *) b, c);
 	case SYSCALL_OBJECT_SIZE:
 		return sys_object_size(a, (int *) b, c);
+	case SYSCALL_OBJECT_RESIZE:
+		return sys_object_resize(a, b);
 	case SYSCALL_OBJECT_MAX:
 		return sys_object_max(a);
+	case SYSCALL_OBJECT_ADDRESS:
+		return sys_object_address(a);
+	case SYSCALL_OBJECT_POLL:
+		return sys_object_poll((struct kernel_poll *) a, b, c);
+	case SYSCALL_RING_ENTER:
+		return sys_ring_enter((struct kernel_ring *) a);
 	case SYSCALL_SYSTEM_STATS:
 		return sys_system_stats((struct system_stats *) a);
 	case SYSCALL_BCACHE_STATS:
 		return sys_bcache_stats((struct bcache_stats *) a);
 	case SYSCALL_BCACHE_FLUSH:
 		return sys_bcache_flush();
+	case SYSCALL_MEMORY_STATS:
+		return sys_memory_stats((struct memory_stats *) a);
+	case SYSCALL_MEMORY_TRACE:
+		return sys_memory_trace(a, (struct memory_trace *) b, c);
+	case SYSCALL_SYSCALL_STATS:
+		return sys_syscall_stats(a, (struct syscall_stats *) b, c);
 	case SYSCALL_SYSTEM_TIME:
 		return sys_system_time((uint32_t*)a);
+	case SYSCALL_SYSTEM_NANOS:
+		return sys_system_nanos((uint64_t*)a);
 	case SYSCALL_SYSTEM_RTC:
 		return sys_system_rtc((struct rtc_time *) a);
 	case SYSCALL_DEVICE_DRIVER_STATS:
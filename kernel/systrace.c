@@ -0,0 +1,138 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+/*
+Latency accounting for system calls.  Every call is charged
+to the calling process and to a system-wide histogram for its
+number.  Optionally, each call is also logged to a ring of
+recent calls, which is drained by reading the systrace device.
+Like memtrace, the ring is off by default and overwrites the
+oldest entries once full.  All of this runs under the kernel
+lock, taken by syscall_handler.
+*/
+
+#include "systrace.h"
+#include "device.h"
+#include "process.h"
+#include "clock.h"
+#include "string.h"
+
+#define SYSTRACE_SIZE 512
+
+static struct syscall_stats stats[MAX_SYSCALL];
+static uint64_t time_ns[MAX_SYSCALL];
+static struct syscall_trace ring[SYSTRACE_SIZE];
+static int ring_head = 0;
+static int ring_count = 0;
+static int enabled = 0;
+
+void systrace_enable(int e)
+{
+	enabled = e;
+	if(!enabled) {
+		ring_head = 0;
+		ring_count = 0;
+	}
+}
+
+static int systrace_bucket(uint32_t micros)
+{
+	int bucket = micros ? 32 - __builtin_clz(micros) : 0;
+	return MIN(bucket, SYSCALL_LATENCY_BUCKETS - 1);
+}
+
+void systrace_record(syscall_t n, uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e, int32_t result, uint64_t start)
+{
+	uint64_t elapsed = clock_nanos() - start;
+	uint32_t nanos = elapsed > 0xffffffff ? 0xffffffff : elapsed;
+	uint32_t micros = nanos / 1000;
+
+	struct syscall_stats *s = &stats[n];
+	if(!s->count || nanos < s->min_ns) s->min_ns = nanos;
+	if(nanos > s->max_ns) s->max_ns = nanos;
+	s->count++;
+	time_ns[n] += elapsed;
+	s->histogram[systrace_bucket(micros)]++;
+
+	if(current) current->syscall_nanos[n] += elapsed;
+
+	if(!enabled)
+		return;
+
+	struct syscall_trace *t = &ring[ring_head];
+	t->pid = current ? current->pid : 0;
+	t->syscall = n;
+	t->args[0] = a;
+	t->args[1] = b;
+	t->args[2] = c;
+	t->args[3] = d;
+	t->args[4] = e;
+	t->result = result;
+	t->nanos = nanos;
+
+	ring_head = (ring_head + 1) % SYSTRACE_SIZE;
+	if(ring_count < SYSTRACE_SIZE)
+		ring_count++;
+}
+
+/*
+Copy out the counters of the first n system calls,
+and return the number copied.
+*/
+
+int systrace_stats(struct syscall_stats *s, int n)
+{
+	int i;
+
+	n = MIN(n, MAX_SYSCALL);
+	memcpy(s, stats, n * sizeof(*s));
+	for(i = 0; i < n; i++) {
+		s[i].time_us = clock_divide(time_ns[i], 1000, 0);
+	}
+	return n;
+}
+
+/*
+The device has one unit whose blocks are trace entries.
+A read removes up to nblocks of the oldest entries and
+returns the number of bytes copied, never blocking.
+*/
+
+static int systrace_probe(int unit, int *nblocks, int *blocksize, char *info)
+{
+	if(unit != 0) return 0;
+	*nblocks = 0;
+	*blocksize = sizeof(struct syscall_trace);
+	strcpy(info, "systrace");
+	return 1;
+}
+
+static int systrace_read(int unit, void *buffer, int nblocks, int offset)
+{
+	struct syscall_trace *t = buffer;
+	int first = (ring_head - ring_count + SYSTRACE_SIZE) % SYSTRACE_SIZE;
+	int i;
+
+	nblocks = MIN(nblocks, ring_count);
+	for(i = 0; i < nblocks; i++) {
+		t[i] = ring[(first + i) % SYSTRACE_SIZE];
+	}
+	ring_count -= nblocks;
+
+	return nblocks * sizeof(*t);
+}
+
+static struct device_driver systrace_driver = {
+	.name          = "systrace",
+	.probe         = systrace_probe,
+	.read          = systrace_read,
+	.read_nonblock = systrace_read,
+};
+
+void systrace_init()
+{
+	device_driver_register(&systrace_driver);
+}
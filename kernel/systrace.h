@@ -0,0 +1,18 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#ifndef SYSTRACE_H
+#define SYSTRACE_H
+
+#include "kernel/types.h"
+#include "kernel/stats.h"
+
+void systrace_init();
+void systrace_enable(int enabled);
+void systrace_record(syscall_t n, uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t e, int32_t result, uint64_t start);
+int  systrace_stats(struct syscall_stats *s, int n);
+
+#endif
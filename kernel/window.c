@@ -25,7 +25,7 @@ struct window * window_create_root()
 
 struct window * window_create( struct window *parent, int x, int y, int width, int height )
 {
-	struct window *w = kmalloc(sizeof(*w));
+	struct window *w = kmalloc_tag(sizeof(*w), MEMORY_TAG_GRAPHICS);
 	w->parent = parent;
 	w->graphics = graphics_create(parent->graphics);
 	graphics_clip(w->graphics,x,y,width,height);
@@ -95,6 +95,11 @@ int  window_read_events_nonblock( struct window *w, struct event *e, int size )
 	return event_queue_read_nonblock(w->queue,e,size);
 }
 
+int  window_poll( struct window *w, uint16_t type, struct poll_waiter *pw )
+{
+	return event_queue_poll(w->queue,type,pw);
+}
+
 int  window_write_graphics( struct window *w, int *cmd, int size )
 {
 	return graphics_write(w->graphics,cmd,size);	
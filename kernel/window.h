@@ -19,6 +19,7 @@ struct graphics * window_graphics( struct window *w );
 int  window_post_events( struct window *w, struct event *e, int size );
 int  window_read_events( struct window *w, struct event *e, int size );
 int  window_read_events_nonblock( struct window *w, struct event *e, int size );
+int  window_poll( struct window *w, uint16_t type, struct poll_waiter *pw );
 int  window_write_graphics( struct window *w, int *cmd, int size );
 
 void window_event_post_root( uint16_t type, uint16_t code, int16_t x, int16_t y );
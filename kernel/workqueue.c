@@ -0,0 +1,155 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#include "workqueue.h"
+#include "process.h"
+#include "kmalloc.h"
+#include "interrupt.h"
+#include "spinlock.h"
+#include "cpu.h"
+#include "printf.h"
+#include "kernel/error.h"
+
+struct workqueue {
+	struct spinlock lock;
+	struct list pending;
+	struct list idle;
+	struct list flushers;
+	int outstanding;
+	int nthreads;
+};
+
+struct workqueue *workqueue_system = 0;
+
+void work_init(struct work *w, void (*func)(void *arg), void *arg)
+{
+	w->func = func;
+	w->arg = arg;
+	w->allocated = 0;
+}
+
+/*
+Interrupts are blocked while the lock is held, so that an
+interrupt handler on the same CPU may submit work.
+*/
+
+static void workqueue_worker(void *arg)
+{
+	struct workqueue *wq = arg;
+	struct work *w;
+	void (*func)(void *arg);
+	void *func_arg;
+
+	while(1) {
+		interrupt_block();
+		spinlock_acquire(&wq->lock);
+
+		w = (struct work *) list_pop_head(&wq->pending);
+		if(!w) {
+			process_wait_locked(&wq->idle, &wq->lock);
+			continue;
+		}
+
+		spinlock_release(&wq->lock);
+		interrupt_unblock();
+
+		/* Once it starts, the item belongs to its submitter again. */
+		func = w->func;
+		func_arg = w->arg;
+		if(w->allocated)
+			kfree(w);
+
+		func(func_arg);
+
+		interrupt_block();
+		spinlock_acquire(&wq->lock);
+		if(--wq->outstanding == 0)
+			process_wakeup_all(&wq->flushers);
+		spinlock_release(&wq->lock);
+		interrupt_unblock();
+	}
+}
+
+struct workqueue *workqueue_create(int nthreads)
+{
+	struct workqueue *wq;
+	struct process *p;
+	int i;
+
+	wq = kmalloc_tag(sizeof(*wq), MEMORY_TAG_PROCESS);
+	if(!wq)
+		return 0;
+
+	spinlock_init(&wq->lock);
+	wq->pending.head = wq->pending.tail = 0;
+	wq->idle.head = wq->idle.tail = 0;
+	wq->flushers.head = wq->flushers.tail = 0;
+	wq->outstanding = 0;
+	wq->nthreads = 0;
+
+	for(i = 0; i < nthreads; i++) {
+		p = process_create_kernel(workqueue_worker, wq);
+		if(!p)
+			break;
+		process_launch(p);
+		wq->nthreads++;
+	}
+
+	/* Workers are never taken back, so a partial pool is kept. */
+	if(wq->nthreads == 0) {
+		kfree(wq);
+		return 0;
+	}
+
+	return wq;
+}
+
+void workqueue_submit_work(struct workqueue *wq, struct work *w)
+{
+	int enabled = interrupt_block_save();
+	spinlock_acquire(&wq->lock);
+	list_push_tail(&wq->pending, &w->node);
+	wq->outstanding++;
+	process_wakeup(&wq->idle);
+	spinlock_release(&wq->lock);
+	interrupt_restore(enabled);
+}
+
+int workqueue_submit(struct workqueue *wq, void (*func)(void *arg), void *arg)
+{
+	struct work *w = kmalloc_tag(sizeof(*w), MEMORY_TAG_PROCESS);
+	if(!w)
+		return KERROR_OUT_OF_MEMORY;
+
+	work_init(w, func, arg);
+	w->allocated = 1;
+	workqueue_submit_work(wq, w);
+
+	return 0;
+}
+
+void workqueue_flush(struct workqueue *wq)
+{
+	int enabled = interrupt_block_save();
+	spinlock_acquire(&wq->lock);
+	while(wq->outstanding > 0) {
+		process_wait_locked(&wq->flushers, &wq->lock);
+		interrupt_block();
+		spinlock_acquire(&wq->lock);
+	}
+	spinlock_release(&wq->lock);
+	interrupt_restore(enabled);
+}
+
+void workqueue_init()
+{
+	workqueue_system = workqueue_create(cpu_count);
+	if(workqueue_system) {
+		printf("workqueue: %d workers\n", workqueue_system->nthreads);
+	} else {
+		printf("workqueue: couldn't start workers\n");
+	}
+}
@@ -0,0 +1,50 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include "list.h"
+
+/*
+A workqueue runs functions on behalf of the kernel in a pool of
+kernel threads.  Each item runs once, on whichever worker takes
+it first, holding the kernel lock.  An item that runs for a long
+time should sleep or yield, since kernel threads are not preempted.
+*/
+
+struct work {
+	struct list_node node;
+	void (*func)(void *arg);
+	void *arg;
+	int allocated;
+};
+
+struct workqueue;
+
+/* The pool shared by the whole kernel, with one worker per CPU. */
+extern struct workqueue *workqueue_system;
+
+void workqueue_init();
+
+struct workqueue *workqueue_create(int nthreads);
+
+/*
+workqueue_submit allocates the item itself, and so must not be
+called from an interrupt.  workqueue_submit_work queues an item
+owned by the caller, which must leave it alone until it has run,
+and may be called from anywhere.
+*/
+
+int  workqueue_submit(struct workqueue *wq, void (*func)(void *arg), void *arg);
+void workqueue_submit_work(struct workqueue *wq, struct work *w);
+
+/* Wait until every item submitted so far has finished.  Not for use by the workers themselves. */
+void workqueue_flush(struct workqueue *wq);
+
+void work_init(struct work *w, void (*func)(void *arg), void *arg);
+
+#endif
@@ -17,6 +17,10 @@ See the file LICENSE for details.
 #define X86_SEGMENT_USER_DATA    X86_SEGMENT_SELECTOR(4,3)
 #define X86_SEGMENT_TSS          X86_SEGMENT_SELECTOR(5,0)
 
+#define X86_MSR_SYSENTER_CS  0x174
+#define X86_MSR_SYSENTER_ESP 0x175
+#define X86_MSR_SYSENTER_EIP 0x176
+
 struct x86_eflags {
 	unsigned carry:1;
 	unsigned reserved0:1;
@@ -50,6 +50,10 @@ const char * strerror( kernel_error_t err_code) {
 			return "Out of Objects";
 		case KERROR_OUT_OF_SPACE:
 			return "Out of Space";
+		case KERROR_TRY_AGAIN:
+			return "Try Again";
+		case KERROR_TIMED_OUT:
+			return "Timed Out";
 		default:
 			return "Unknown error";
 	}
@@ -25,6 +25,20 @@
 
 #define sbrk(x) syscall_process_heap(x)
 
+/* Threads share the heap, so serialize it with the library mutex. */
+#include "library/thread.h"
+#define LACKS_SCHED_H
+#define USE_LOCKS 2
+#define MLOCK_T struct mutex
+static int malloc_init_lock(struct mutex *m) { mutex_init(m); return 0; }
+static int malloc_acquire_lock(struct mutex *m) { mutex_lock(m); return 0; }
+#define INITIAL_LOCK(lk) malloc_init_lock(lk)
+#define DESTROY_LOCK(lk) (0)
+#define ACQUIRE_LOCK(lk) malloc_acquire_lock(lk)
+#define RELEASE_LOCK(lk) mutex_unlock(lk)
+#define TRY_LOCK(lk) mutex_trylock(lk)
+static MLOCK_T malloc_global_mutex = MUTEX_INIT;
+
 /* END CUSTOM SETTINGS */
 /* Below is the unedited dlmalloc code */
 /*
@@ -0,0 +1,100 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#include "library/ring.h"
+#include "library/syscalls.h"
+#include "library/malloc.h"
+#include "library/string.h"
+
+/* Set up an empty ring; entries is rounded up to a power of two. */
+
+int ring_init(struct kernel_ring *r, int entries)
+{
+	uint32_t n = 1;
+
+	if(entries <= 0 || entries > KERNEL_RING_MAX_ENTRIES)
+		return -1;
+	while(n < (uint32_t) entries)
+		n *= 2;
+
+	memset(r, 0, sizeof(*r));
+	r->sq = malloc(n * sizeof(*r->sq));
+	r->cq = malloc(n * sizeof(*r->cq));
+	if(!r->sq || !r->cq) {
+		ring_free(r);
+		return -1;
+	}
+	r->entries = n;
+	return 0;
+}
+
+void ring_free(struct kernel_ring *r)
+{
+	free(r->sq);
+	free(r->cq);
+	r->sq = 0;
+	r->cq = 0;
+	r->entries = 0;
+}
+
+static int ring_queue(struct kernel_ring *r, int opcode, int fd, uint32_t addr, int length, int flags, uint32_t user_data)
+{
+	struct kernel_ring_sqe *e;
+
+	if(r->sq_tail - r->sq_head >= r->entries)
+		return -1;
+
+	e = &r->sq[r->sq_tail & (r->entries - 1)];
+	e->opcode = opcode;
+	e->fd = fd;
+	e->addr = addr;
+	e->length = length;
+	e->flags = flags;
+	e->user_data = user_data;
+	r->sq_tail++;
+
+	return 0;
+}
+
+int ring_read(struct kernel_ring *r, int fd, void *data, int length, kernel_io_flags_t flags, uint32_t user_data)
+{
+	return ring_queue(r, KERNEL_RING_READ, fd, (uint32_t) data, length, flags, user_data);
+}
+
+int ring_write(struct kernel_ring *r, int fd, const void *data, int length, kernel_io_flags_t flags, uint32_t user_data)
+{
+	return ring_queue(r, KERNEL_RING_WRITE, fd, (uint32_t) data, length, flags, user_data);
+}
+
+int ring_open(struct kernel_ring *r, int dirfd, const char *path, kernel_flags_t flags, uint32_t user_data)
+{
+	return ring_queue(r, KERNEL_RING_OPEN, dirfd, (uint32_t) path, 0, flags, user_data);
+}
+
+int ring_close(struct kernel_ring *r, int fd, uint32_t user_data)
+{
+	return ring_queue(r, KERNEL_RING_CLOSE, fd, 0, 0, 0, user_data);
+}
+
+/* Carry out everything queued, and return how many were consumed. */
+
+int ring_submit(struct kernel_ring *r)
+{
+	if(r->sq_head == r->sq_tail)
+		return 0;
+	return syscall_ring_enter(r);
+}
+
+/* Take the next completion, returning zero if there is none. */
+
+int ring_complete(struct kernel_ring *r, struct kernel_ring_cqe *c)
+{
+	if(r->cq_head == r->cq_tail)
+		return 0;
+	*c = r->cq[r->cq_head & (r->entries - 1)];
+	r->cq_head++;
+	return 1;
+}
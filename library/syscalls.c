@@ -7,6 +7,7 @@ See the file LICENSE for details.
 #include "kernel/syscall.h"
 #include "kernel/stats.h"
 #include "kernel/gfxstream.h"
+#include "kernel/ring.h"
 
 void syscall_debug(const char *str)
 {
@@ -83,6 +84,36 @@ extern void *syscall_process_heap(int a)
 	return (void *) syscall(SYSCALL_PROCESS_HEAP, a, 0, 0, 0, 0);
 }
 
+int syscall_process_nice(int pid, int nice)
+{
+	return syscall(SYSCALL_PROCESS_NICE, pid, nice, 0, 0, 0);
+}
+
+int syscall_thread_create(void *entry, void *stack)
+{
+	return syscall(SYSCALL_THREAD_CREATE, (uint32_t) entry, (uint32_t) stack, 0, 0, 0);
+}
+
+void syscall_thread_exit(int status)
+{
+	syscall(SYSCALL_THREAD_EXIT, status, 0, 0, 0, 0);
+}
+
+int syscall_thread_join(int tid, int *status)
+{
+	return syscall(SYSCALL_THREAD_JOIN, tid, (uint32_t) status, 0, 0, 0);
+}
+
+int syscall_futex_wait(volatile int *addr, int expected, int timeout)
+{
+	return syscall(SYSCALL_FUTEX_WAIT, (uint32_t) addr, expected, timeout, 0, 0);
+}
+
+int syscall_futex_wake(volatile int *addr, int count)
+{
+	return syscall(SYSCALL_FUTEX_WAKE, (uint32_t) addr, count, 0, 0, 0);
+}
+
 int syscall_open_file( int fd, const char *path, int mode, kernel_flags_t flags)
 {
 	return syscall(SYSCALL_OPEN_FILE, fd, (uint32_t) path, mode, flags, 0);
@@ -103,9 +134,19 @@ int syscall_open_console(int wd)
 	return syscall(SYSCALL_OPEN_CONSOLE, wd, 0, 0, 0, 0);
 }
 
-int syscall_open_pipe()
+int syscall_open_pipe(int size)
 {
-	return syscall(SYSCALL_OPEN_PIPE, 0, 0, 0, 0, 0);
+	return syscall(SYSCALL_OPEN_PIPE, size, 0, 0, 0, 0);
+}
+
+int syscall_open_shmem(int size)
+{
+	return syscall(SYSCALL_OPEN_SHMEM, size, 0, 0, 0, 0);
+}
+
+int syscall_open_systrace()
+{
+	return syscall(SYSCALL_OPEN_SYSTRACE, 0, 0, 0, 0, 0);
 }
 
 int syscall_object_type(int fd)
@@ -118,6 +159,11 @@ int syscall_object_copy( int src, int dst )
 	return syscall(SYSCALL_OBJECT_COPY,src,dst,0,0,0);
 }
 
+int syscall_object_transfer(int src, int dst, int length)
+{
+	return syscall(SYSCALL_OBJECT_TRANSFER, src, dst, length, 0, 0);
+}
+
 int syscall_object_read(int fd, void *data, int length, kernel_io_flags_t flags )
 {
 	return syscall(SYSCALL_OBJECT_READ, fd, (uint32_t) data, length, flags, 0);
@@ -163,16 +209,51 @@ int syscall_object_size(int fd, int *dims, int n)
 	return syscall(SYSCALL_OBJECT_SIZE, fd, (uint32_t) dims, n, 0, 0);
 }
 
+int syscall_object_resize(int fd, int size)
+{
+	return syscall(SYSCALL_OBJECT_RESIZE, fd, size, 0, 0, 0);
+}
+
 int syscall_object_max()
 {
 	return syscall(SYSCALL_OBJECT_MAX, 0, 0, 0, 0, 0);
 }
 
+void *syscall_object_address(int fd)
+{
+	return (void *) syscall(SYSCALL_OBJECT_ADDRESS, fd, 0, 0, 0, 0);
+}
+
+int syscall_object_poll(struct kernel_poll *fds, int n, int timeout)
+{
+	return syscall(SYSCALL_OBJECT_POLL, (uint32_t) fds, n, timeout, 0, 0);
+}
+
+int syscall_ring_enter(struct kernel_ring *r)
+{
+	return syscall(SYSCALL_RING_ENTER, (uint32_t) r, 0, 0, 0, 0);
+}
+
 int syscall_system_stats(struct system_stats *s)
 {
 	return syscall(SYSCALL_SYSTEM_STATS, (uint32_t) s, 0, 0, 0, 0);
 }
 
+int syscall_memory_stats(struct memory_stats *s)
+{
+	return syscall(SYSCALL_MEMORY_STATS, (uint32_t) s, 0, 0, 0, 0);
+}
+
+int syscall_memory_trace(int enable, struct memory_trace *t, int n)
+{
+	return syscall(SYSCALL_MEMORY_TRACE, enable, (uint32_t) t, n, 0, 0);
+}
+
+int syscall_syscall_stats(int enable, struct syscall_stats *s, int n)
+{
+	return syscall(SYSCALL_SYSCALL_STATS, enable, (uint32_t) s, n, 0, 0);
+}
+
 int syscall_bcache_stats(struct bcache_stats *bstats)
 {
 	return syscall(SYSCALL_BCACHE_STATS, (uint32_t) bstats, 0, 0, 0, 0);
@@ -188,6 +269,11 @@ int syscall_system_time( uint32_t *t )
 	return syscall(SYSCALL_SYSTEM_TIME, (uint32_t)t, 0, 0, 0, 0);
 }
 
+int syscall_system_nanos( uint64_t *ns )
+{
+	return syscall(SYSCALL_SYSTEM_NANOS, (uint32_t)ns, 0, 0, 0, 0);
+}
+
 int syscall_system_rtc( struct rtc_time *time )
 {
 	return syscall(SYSCALL_SYSTEM_RTC, (uint32_t)time, 0, 0, 0, 0);
@@ -0,0 +1,120 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#include "library/thread.h"
+#include "library/syscalls.h"
+#include "library/malloc.h"
+
+#define MUTEX_SPINS 100
+
+struct thread {
+	int tid;
+	int (*func)(void *arg);
+	void *arg;
+	char *stack;
+};
+
+/*
+The kernel starts a new thread here, with the stack prepared
+by thread_create so that t appears as the only argument.
+*/
+
+static void thread_start(struct thread *t)
+{
+	syscall_thread_exit(t->func(t->arg));
+}
+
+struct thread *thread_create(int (*func)(void *arg), void *arg)
+{
+	struct thread *t;
+	unsigned *sp;
+
+	t = malloc(sizeof(*t));
+	if(!t)
+		return 0;
+
+	t->func = func;
+	t->arg = arg;
+	t->stack = malloc(THREAD_STACK_SIZE);
+	if(!t->stack) {
+		free(t);
+		return 0;
+	}
+
+	/* An argument and a return address that is never used. */
+	sp = (unsigned *) (t->stack + THREAD_STACK_SIZE);
+	*--sp = (unsigned) t;
+	*--sp = 0;
+
+	t->tid = syscall_thread_create(thread_start, sp);
+	if(t->tid < 0) {
+		free(t->stack);
+		free(t);
+		return 0;
+	}
+
+	return t;
+}
+
+/*
+Wait for t to finish, and release it.
+Returns zero or a negative error code.
+*/
+
+int thread_join(struct thread *t, int *status)
+{
+	int r = syscall_thread_join(t->tid, status);
+	if(r < 0)
+		return r;
+
+	free(t->stack);
+	free(t);
+	return 0;
+}
+
+void thread_exit(int status)
+{
+	syscall_thread_exit(status);
+}
+
+int thread_id(struct thread *t)
+{
+	return t->tid;
+}
+
+void mutex_init(struct mutex *m)
+{
+	m->locked = 0;
+}
+
+int mutex_trylock(struct mutex *m)
+{
+	return __sync_val_compare_and_swap(&m->locked, 0, 1) == 0;
+}
+
+void mutex_lock(struct mutex *m)
+{
+	int spins;
+
+	for(spins = 0; spins < MUTEX_SPINS; spins++) {
+		if(mutex_trylock(m))
+			return;
+		asm volatile ("pause");
+	}
+
+	/* Announce a sleeper, and sleep until the word changes from 2. */
+	while(__sync_lock_test_and_set(&m->locked, 2) != 0) {
+		syscall_futex_wait(&m->locked, 2, -1);
+	}
+}
+
+void mutex_unlock(struct mutex *m)
+{
+	if(__sync_fetch_and_sub(&m->locked, 1) != 1) {
+		m->locked = 0;
+		syscall_futex_wake(&m->locked, 1);
+	}
+}
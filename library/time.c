@@ -0,0 +1,28 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+#include "library/time.h"
+#include "library/syscalls.h"
+#include "kernel/timepage.h"
+
+/*
+Nanoseconds since boot.  Read the timestamp counter directly using
+the parameters on the kernel's time page, and only fall back to a
+syscall if the kernel could not calibrate it.
+*/
+
+uint64_t time_nanos()
+{
+	const struct time_page *t = (const struct time_page *) TIME_PAGE_ADDRESS;
+	uint64_t ns = 0;
+
+	if(t->tsc_valid) {
+		return time_page_nanos(t);
+	}
+
+	syscall_system_nanos(&ns);
+	return ns;
+}
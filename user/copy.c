@@ -21,17 +21,27 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	int dst = syscall_open_file(KNO_STDDIR,argv[2],0,0);
+	int size;
+	int result = syscall_object_size(src,&size,1);
+	if(result<0) {
+		printf("couldn't size %s: %s\n",argv[1],strerror(result));
+		return 1;
+	}
+
+	int dst = syscall_open_file(KNO_STDDIR,argv[2],0,KERNEL_FLAGS_CREATE);
 	if(dst<0) {
 		printf("couldn't open %s: %s\n",argv[2],strerror(dst));
 		return 1;
 	}
 
 	printf("copying %s to %s...\n",argv[1],argv[2]);
-	int result = syscall_object_copy(src,dst);
+	result = syscall_object_transfer(src,dst,size);
 	if(result<0) {
 		printf("copy failed: %s\n",strerror(result));
 		return 1;
+	} else if(result<size) {
+		printf("copy stopped after %d of %d bytes\n",result,size);
+		return 1;
 	}
 
 	printf("copy complete\n");
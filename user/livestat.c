@@ -213,6 +213,16 @@ int extract_statistic(struct stat_args * args) {
       return ((struct process_stats *)args->statistics)->bytes_written;
     } else if (!strcmp(args->stat_name, "syscall_count")) {
       return ((struct process_stats *)args->statistics)->syscall_count[args->syscall_index];
+    } else if (!strcmp(args->stat_name, "user_time")) {
+      return ((struct process_stats *)args->statistics)->user_time;
+    } else if (!strcmp(args->stat_name, "kernel_time")) {
+      return ((struct process_stats *)args->statistics)->kernel_time;
+    } else if (!strcmp(args->stat_name, "wait_time")) {
+      return ((struct process_stats *)args->statistics)->wait_time;
+    } else if (!strcmp(args->stat_name, "voluntary_switches")) {
+      return ((struct process_stats *)args->statistics)->voluntary_switches;
+    } else if (!strcmp(args->stat_name, "involuntary_switches")) {
+      return ((struct process_stats *)args->statistics)->involuntary_switches;
     }
   }
   else if (args->stat_type == DRIVER_LIVE) {
@@ -225,6 +235,10 @@ int extract_statistic(struct stat_args * args) {
   else if (args->stat_type == SYSTEM_LIVE) {
     if (!strcmp(args->stat_name, "time")) {
       return ((struct system_stats *)args->statistics)->time;
+    } else if (!strcmp(args->stat_name, "idle_time")) {
+      return ((struct system_stats *)args->statistics)->idle_time;
+    } else if (!strcmp(args->stat_name, "cpu_utilization")) {
+      return ((struct system_stats *)args->statistics)->cpu_utilization;
     } else if (!strcmp(args->stat_name, "blocks_read")) {
       return ((struct system_stats *)args->statistics)->blocks_read[args->device_unit];
     } else if (!strcmp(args->stat_name, "blocks_written")) {
@@ -366,7 +380,12 @@ void help() {
   printf("    blocks_written\n");
   printf("    bytes_read\n");
   printf("    bytes_written\n");
-  printf("    syscall_count\n\n");
+  printf("    syscall_count\n");
+  printf("    user_time\n");
+  printf("    kernel_time\n");
+  printf("    wait_time\n");
+  printf("    voluntary_switches\n");
+  printf("    involuntary_switches\n\n");
 
   printf("\nDriver STAT_NAME options:\n");
   printf("    blocks_read\n");
@@ -374,6 +393,8 @@ void help() {
 
   printf("\nSystem STAT_NAME options:\n");
   printf("    time\n");
+  printf("    idle_time\n");
+  printf("    cpu_utilization\n");
   printf("    blocks_read\n");
   printf("    blocks_written\n\n");
 
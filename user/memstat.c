@@ -0,0 +1,70 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+/*
+Show kernel memory use broken down by subsystem.
+"memstat trace on" starts recording allocations,
+"memstat trace" prints (and clears) what has been recorded,
+and "memstat trace off" stops recording.
+*/
+
+#include "library/syscalls.h"
+#include "library/string.h"
+#include "library/stdio.h"
+
+static const char *tag_names[MEMORY_TAG_MAX] = {
+	"other", "kmalloc", "process", "pagetable", "user", "bcache", "pipe", "graphics", "fs"
+};
+
+static int show_trace(int enable)
+{
+	struct memory_trace t[32];
+	int i, n;
+
+	do {
+		n = syscall_memory_trace(enable, t, 32);
+		if(n < 0) {
+			printf("memstat: couldn't read trace: %d\n", n);
+			return 1;
+		}
+		for(i = 0; i < n; i++) {
+			printf("%s %s site %x addr %x %d bytes\n",
+				t[i].source == MEMORY_TRACE_PAGE ? "page" : "kmalloc",
+				tag_names[t[i].tag], t[i].site, t[i].addr, t[i].length);
+		}
+		enable = -1;
+	} while(n > 0);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct memory_stats s = {0};
+	int i;
+
+	if(argc > 1 && !strcmp(argv[1], "trace")) {
+		if(argc > 2 && !strcmp(argv[2], "on")) {
+			return syscall_memory_trace(1, 0, 0) < 0;
+		} else if(argc > 2 && !strcmp(argv[2], "off")) {
+			return syscall_memory_trace(0, 0, 0) < 0;
+		} else {
+			return show_trace(-1);
+		}
+	}
+
+	if(syscall_memory_stats(&s)) {
+		return 1;
+	}
+
+	printf("Pages: %d free of %d (%d KB free)\n", s.pages_free, s.pages_total, s.pages_free * 4);
+	printf("subsystem\tpages\tpeak\tkmalloc\tpeak\tchunks\n");
+	for(i = 0; i < MEMORY_TAG_MAX; i++) {
+		printf("%s\t%d\t%d\t%d\t%d\t%d\n", tag_names[i], s.pages[i], s.pages_peak[i], s.kmalloc_bytes[i], s.kmalloc_peak[i], s.kmalloc_count[i]);
+	}
+
+	return 0;
+}
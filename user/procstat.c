@@ -48,11 +48,20 @@ int main(int argc, const char *argv[])
 	printf("Time elapsed: %d:%d:%d\n", timeElapsed/3600, (timeElapsed%3600)/60, timeElapsed % 60);
 	printf("%d blocks read, %d blocks written\n", stat.blocks_read, stat.blocks_written);
 	printf("%d bytes read, %d bytes written\n", stat.bytes_read, stat.bytes_written);
+	printf("%d KB data, %d KB stack, %d KB resident\n", stat.vm_data_size / 1024, stat.vm_stack_size / 1024, stat.resident_pages * 4);
+	printf("%d ms running (%d ms user, %d ms kernel), %d ms waiting to run, nice %d\n", stat.run_time, stat.user_time, stat.kernel_time, stat.wait_time, stat.nice);
+	printf("%d voluntary and %d involuntary context switches\n", stat.voluntary_switches, stat.involuntary_switches);
+
+	printf("Waits to run:\n");
+	const char *bucket_names[PROCESS_WAIT_BUCKETS] = { "<10us", "<100us", "<1ms", "<10ms", "<100ms", ">=100ms" };
+	for (int i = 0; i < PROCESS_WAIT_BUCKETS; i++) {
+		printf("%s: %d\n", bucket_names[i], stat.wait_histogram[i]);
+	}
 
 	printf("System calls used:\n");
 	for (int i = 0; i < MAX_SYSCALL; i++) {
 		if (stat.syscall_count[i]) {
-			printf("Syscall %d: %u\n", i, stat.syscall_count[i]);
+			printf("Syscall %d: %u calls, %u us\n", i, stat.syscall_count[i], stat.syscall_time[i]);
 		}
 	}
 
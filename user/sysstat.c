@@ -18,6 +18,7 @@ int main(int argc, char *argv[])
 	}
 
 	printf("System uptime: %u:%u:%u\n", s.time / (3600), (s.time % 3600) / 60, s.time % 60);
+	printf("CPUs: %d, idle time: %d ms, CPU utilization %d%%\n", s.cpu_count, s.idle_time, s.cpu_utilization);
 	printf("Disk 0: %d blocks read, %d blocks written\n", s.blocks_read[0], s.blocks_written[0]);
 	printf("Disk 1: %d blocks read, %d blocks written\n", s.blocks_read[1], s.blocks_written[1]);
 	printf("Disk 2: %d blocks read, %d blocks written\n", s.blocks_read[2], s.blocks_written[2]);
@@ -0,0 +1,116 @@
+/*
+Copyright (C) 2016-2019 The University of Notre Dame
+This software is distributed under the GNU General Public License.
+See the file LICENSE for details.
+*/
+
+/*
+Show where the system spends its time in system calls.
+With no arguments, print the count, total time, and latency
+of every system call used so far, with the median and 99th
+percentile taken from the latency histogram.
+"systrace on" starts logging each call, "systrace off" stops,
+and "systrace dump" prints (and clears) the logged calls,
+as read from the systrace device.
+*/
+
+#include "library/syscalls.h"
+#include "library/string.h"
+#include "library/stdio.h"
+#include "library/malloc.h"
+
+/* The upper bound of the histogram bucket holding the given fraction of calls. */
+
+static uint32_t percentile(struct syscall_stats *s, uint32_t target)
+{
+	uint32_t total = 0;
+	int i;
+
+	for(i = 0; i < SYSCALL_LATENCY_BUCKETS - 1; i++) {
+		total += s->histogram[i];
+		if(total >= target) break;
+	}
+
+	return 1 << i;
+}
+
+static int show_stats()
+{
+	struct syscall_stats s[MAX_SYSCALL];
+	int i, n;
+
+	n = syscall_syscall_stats(-1, s, MAX_SYSCALL);
+	if(n < 0) {
+		printf("systrace: couldn't read stats: %d\n", n);
+		return 1;
+	}
+
+	printf("syscall\tcalls\ttime us\tmin ns\tmax ns\tp50 us\tp99 us\n");
+	for(i = 0; i < n; i++) {
+		if(!s[i].count) continue;
+		printf("%d\t%u\t%u\t%u\t%u\t<%u\t<%u\n", i, s[i].count, s[i].time_us, s[i].min_ns, s[i].max_ns,
+			percentile(&s[i], (s[i].count + 1) / 2), percentile(&s[i], s[i].count - s[i].count / 100));
+	}
+
+	return 0;
+}
+
+/*
+Drain the whole ring before printing anything, since each
+read and each line printed is itself a system call that would
+land in the ring.  A short read means the ring is empty, apart
+from the read that found it so.
+*/
+
+#define TRACE_MAX 1024
+#define TRACE_CHUNK 64
+
+static int show_trace()
+{
+	struct syscall_trace *t;
+	int fd, i, n, total = 0;
+
+	fd = syscall_open_systrace();
+	if(fd < 0) {
+		printf("systrace: couldn't open device: %d\n", fd);
+		return 1;
+	}
+
+	t = malloc(sizeof(*t) * TRACE_MAX);
+	if(!t) {
+		syscall_object_close(fd);
+		return 1;
+	}
+
+	while(total < TRACE_MAX) {
+		n = syscall_object_read(fd, &t[total], sizeof(*t) * MIN(TRACE_CHUNK, TRACE_MAX - total), 0);
+		if(n <= 0) break;
+		n /= sizeof(*t);
+		total += n;
+		if(n < TRACE_CHUNK) break;
+	}
+
+	syscall_object_close(fd);
+
+	for(i = 0; i < total; i++) {
+		printf("pid %u syscall %u (%x %x %x %x %x) = %d in %u ns\n",
+			t[i].pid, t[i].syscall, t[i].args[0], t[i].args[1], t[i].args[2],
+			t[i].args[3], t[i].args[4], t[i].result, t[i].nanos);
+	}
+
+	free(t);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	if(argc > 1 && !strcmp(argv[1], "on")) {
+		return syscall_syscall_stats(1, 0, 0) < 0;
+	} else if(argc > 1 && !strcmp(argv[1], "off")) {
+		return syscall_syscall_stats(0, 0, 0) < 0;
+	} else if(argc > 1 && !strcmp(argv[1], "dump")) {
+		return show_trace();
+	} else {
+		return show_stats();
+	}
+}
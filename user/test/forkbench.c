@@ -0,0 +1,63 @@
+#include "library/syscalls.h"
+#include "library/string.h"
+#include "library/time.h"
+#include "library/errno.h"
+
+/*
+Measure fork, exit, and wait throughput by creating many
+short-lived children.  Each round forks a batch of children
+that exit immediately, then waits for and reaps all of them,
+so the process table churns through thousands of pids while
+the parent always has a batch of children outstanding.
+
+Usage: forkbench [children] [batch]
+*/
+
+int main(int argc, char *argv[])
+{
+	int total = 4000;
+	int batch = 50;
+	int done = 0;
+	int i;
+	uint32_t elapsed_us = 0;
+	struct process_info info;
+
+	if(argc > 1) str2int(argv[1], &total);
+	if(argc > 2) str2int(argv[2], &batch);
+	if(batch < 1) batch = 1;
+
+	while(done < total) {
+		int n = total - done < batch ? total - done : batch;
+		uint64_t start = time_nanos();
+
+		for(i = 0; i < n; i++) {
+			int pid = syscall_process_fork();
+			if(pid == 0) {
+				syscall_process_exit(i);
+			} else if(pid < 0) {
+				printf("forkbench: fork failed: %s\n", strerror(pid));
+				return 1;
+			}
+		}
+
+		for(i = 0; i < n; i++) {
+			if(syscall_process_wait(&info, -1) <= 0) {
+				printf("forkbench: wait failed\n");
+				return 1;
+			}
+			syscall_process_reap(info.pid);
+		}
+
+		/* Timed per batch, so the 64-bit difference fits before dividing. */
+		elapsed_us += (uint32_t) (time_nanos() - start) / 1000;
+		done += n;
+	}
+
+	uint32_t elapsed_ms = elapsed_us / 1000;
+	if(elapsed_ms == 0) elapsed_ms = 1;
+
+	printf("%d children in batches of %d: %u ms\n", total, batch, elapsed_ms);
+	printf("%u us per fork/exit/wait, %u children per second\n", elapsed_us / total, (uint32_t) total * 1000 / elapsed_ms);
+
+	return 0;
+}
@@ -0,0 +1,45 @@
+/*
+Check the corner cases of futex wait and wake:
+a stale expected value, a timeout, and a real wakeup.
+*/
+
+#include "library/syscalls.h"
+#include "library/string.h"
+#include "library/thread.h"
+
+static volatile int word = 0;
+
+static int waker(void *arg)
+{
+	syscall_process_sleep(100);
+	word = 1;
+	return syscall_futex_wake(&word, 1);
+}
+
+int main(int argc, char *argv[])
+{
+	struct thread *t;
+	int r, status, errors = 0;
+
+	r = syscall_futex_wait(&word, 1, -1);
+	printf("wait on stale value: %d (expect %d)\n", r, KERROR_TRY_AGAIN);
+	errors += r != KERROR_TRY_AGAIN;
+
+	r = syscall_futex_wait(&word, 0, 50);
+	printf("wait with timeout: %d (expect %d)\n", r, KERROR_TIMED_OUT);
+	errors += r != KERROR_TIMED_OUT;
+
+	r = syscall_futex_wake(&word, 1);
+	printf("wake with no waiters: %d (expect 0)\n", r);
+	errors += r != 0;
+
+	t = thread_create(waker, 0);
+	while(word == 0) {
+		syscall_futex_wait(&word, 0, -1);
+	}
+	thread_join(t, &status);
+	printf("woken by thread, which woke %d\n", status);
+
+	printf("futextest: %s\n", errors ? "FAILED" : "passed");
+	return errors;
+}
@@ -0,0 +1,61 @@
+#include "library/syscalls.h"
+#include "library/string.h"
+#include "library/time.h"
+
+/*
+Measure how quickly a blocked process gets the CPU back
+while other processes are busy computing.  Waking from a
+short sleep stands in for a keypress: both are an interrupt
+making a waiting process ready, and the delay before it runs
+is what the user sees as echo latency.
+
+Usage: latency [hogs] [seconds]
+*/
+
+static void hog()
+{
+	volatile unsigned x = 0;
+	while(1) x++;
+}
+
+int main(int argc, char *argv[])
+{
+	int nhogs = 2;
+	int duration = 5;
+	int pids[16];
+	int i;
+
+	if(argc > 1) str2int(argv[1], &nhogs);
+	if(argc > 2) str2int(argv[2], &duration);
+	if(nhogs > 16) nhogs = 16;
+
+	for(i = 0; i < nhogs; i++) {
+		pids[i] = syscall_process_fork();
+		if(pids[i] == 0) hog();
+	}
+
+	uint32_t start, now;
+	uint32_t total_us = 0, worst_us = 0;
+	int wakeups = 0;
+
+	syscall_system_time(&start);
+	do {
+		uint64_t before = time_nanos();
+		syscall_process_sleep(1);
+		uint32_t late_us = (uint32_t) (time_nanos() - before) / 1000 - 1000;
+		total_us += late_us;
+		if(late_us > worst_us) worst_us = late_us;
+		wakeups++;
+		syscall_system_time(&now);
+	} while(now - start < duration);
+
+	for(i = 0; i < nhogs; i++) {
+		syscall_process_kill(pids[i]);
+		syscall_process_reap(pids[i]);
+	}
+
+	printf("%d wakeups in %d seconds with %d busy processes\n", wakeups, now - start, nhogs);
+	printf("wakeup latency beyond the 1ms sleep: %u us average, %u us worst\n", total_us / wakeups, worst_us);
+
+	return 0;
+}
@@ -0,0 +1,91 @@
+#include "library/syscalls.h"
+#include "library/string.h"
+#include "library/time.h"
+
+/*
+Measure pipe throughput for small, page-sized, and large writes.
+A child writes the data in pieces of the given size, while the
+parent reads it back in 64 KB pieces, timing each read so that
+each 64-bit difference fits in 32 bits before dividing.
+Writes of a page or more go straight from the writer's pages
+to the reader, and so should run well ahead of small writes.
+
+Usage: pipebench [megabytes] [pipe capacity in KB]
+*/
+
+#define CHUNK (64 * 1024)
+
+static char wbuf[CHUNK];
+static char rbuf[CHUNK];
+static int capacity = 0;
+
+static int run(int wsize, int total)
+{
+	uint32_t elapsed_us = 0;
+	int fd = syscall_open_pipe(capacity);
+	int done, pid, i;
+
+	if(fd < 0) {
+		printf("pipebench: couldn't open pipe: %d\n", fd);
+		return 1;
+	}
+
+	pid = syscall_process_fork();
+	if(pid == 0) {
+		for(i = 0; i < total; i += wsize) {
+			syscall_object_write(fd, wbuf, wsize, 0);
+		}
+		syscall_process_exit(0);
+	} else if(pid < 0) {
+		printf("pipebench: fork failed: %d\n", pid);
+		return 1;
+	}
+
+	for(done = 0; done < total; done += CHUNK) {
+		uint64_t start = time_nanos();
+		int n = syscall_object_read(fd, rbuf, CHUNK, 0);
+		elapsed_us += (uint32_t) (time_nanos() - start) / 1000;
+		if(n != CHUNK) {
+			printf("pipebench: short read of %d\n", n);
+			return 1;
+		}
+		for(i = 0; i < CHUNK; i++) {
+			if(rbuf[i] != wbuf[(done + i) % wsize]) {
+				printf("pipebench: data corrupted at %d\n", done + i);
+				return 1;
+			}
+		}
+	}
+
+	struct process_info info;
+	syscall_process_wait(&info, -1);
+	syscall_process_reap(info.pid);
+	syscall_object_close(fd);
+
+	if(elapsed_us == 0) elapsed_us = 1;
+	uint32_t tenths = (uint32_t) total * 10 / elapsed_us;
+	printf("%d byte writes: %d KB in %u us, %u.%u MB/s\n", wsize, total / 1024, elapsed_us, tenths / 10, tenths % 10);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int megabytes = 16;
+	int i;
+
+	if(argc > 1) str2int(argv[1], &megabytes);
+	if(megabytes < 1) megabytes = 1;
+	if(argc > 2) str2int(argv[2], &capacity);
+	capacity *= 1024;
+
+	for(i = 0; i < CHUNK; i++) {
+		wbuf[i] = i * 7;
+	}
+
+	if(run(1, 4 * CHUNK)) return 1;
+	if(run(4096, megabytes * 1024 * 1024)) return 1;
+	if(run(CHUNK, megabytes * 1024 * 1024)) return 1;
+
+	return 0;
+}
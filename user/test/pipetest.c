@@ -5,7 +5,7 @@
 int main(int argc, char *argv[])
 {
 	printf("%d: Running pipe test!\n", syscall_process_self());
-	int w = syscall_open_pipe();
+	int w = syscall_open_pipe(0);
 	syscall_object_set_blocking(w, 0);
 	int x = syscall_process_fork();
 	if(x) {
@@ -0,0 +1,64 @@
+#include "library/syscalls.h"
+#include "library/string.h"
+
+/*
+Wait on two pipes and the console at once.  Two children write
+to their own pipe after different delays, and the parent reports
+each message as it becomes readable, along with any keypresses,
+until both children are done.  Finally, a poll with nothing
+ready should time out.
+*/
+
+static void writer(int fd, int delay, const char *msg)
+{
+	syscall_process_sleep(delay);
+	syscall_object_write(fd, (void *) msg, strlen(msg), 0);
+	syscall_process_exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct kernel_poll fds[3];
+	char buf[64];
+	int done = 0;
+	int i, n;
+
+	int a = syscall_open_pipe(0);
+	int b = syscall_open_pipe(0);
+
+	if(syscall_process_fork() == 0) writer(a, 500, "slow hello");
+	if(syscall_process_fork() == 0) writer(b, 100, "quick hello");
+
+	fds[0].fd = a;
+	fds[1].fd = b;
+	fds[2].fd = KNO_STDIN;
+	for(i = 0; i < 3; i++) fds[i].events = KERNEL_POLL_READ;
+
+	while(done < 2) {
+		n = syscall_object_poll(fds, 3, 5000);
+		if(n <= 0) {
+			printf("polltest: poll returned %d\n", n);
+			return 1;
+		}
+		for(i = 0; i < 3; i++) {
+			if(!(fds[i].revents & KERNEL_POLL_READ)) continue;
+			int r = syscall_object_read(fds[i].fd, buf, sizeof(buf) - 1, KERNEL_IO_NONBLOCK);
+			if(r <= 0) continue;
+			buf[r] = 0;
+			if(i < 2) {
+				printf("polltest: pipe %d: %s\n", i, buf);
+				fds[i].events = 0;
+				done++;
+			} else {
+				printf("polltest: key: %s\n", buf);
+			}
+		}
+	}
+
+	fds[0].events = KERNEL_POLL_READ;
+	fds[1].events = KERNEL_POLL_READ;
+	n = syscall_object_poll(fds, 2, 200);
+	printf("polltest: idle poll returned %d (expected 0)\n", n);
+
+	return 0;
+}
@@ -0,0 +1,81 @@
+#include "library/syscalls.h"
+#include "library/string.h"
+#include "library/time.h"
+#include "library/ring.h"
+
+/*
+Compare one syscall per operation against batching through a
+submission ring.  Both versions move the same bytes through a pipe
+one byte at a time: each round writes a batch of single bytes and
+then reads them back.  The ring version queues a whole round and
+enters the kernel once for it.
+
+Usage: ringbench [bytes] [batch]
+*/
+
+#define MAX_BATCH 512
+
+static char data[MAX_BATCH];
+static char back[MAX_BATCH];
+
+int main(int argc, char *argv[])
+{
+	int total = 20000;
+	int batch = 64;
+	int done, i, n;
+	uint32_t direct_us = 0, ring_us = 0;
+	int direct_traps = 0, ring_traps = 0;
+	struct kernel_ring ring;
+	struct kernel_ring_cqe c;
+	uint64_t start;
+
+	if(argc > 1) str2int(argv[1], &total);
+	if(argc > 2) str2int(argv[2], &batch);
+	if(batch < 1) batch = 1;
+	if(batch > MAX_BATCH) batch = MAX_BATCH;
+
+	int fd = syscall_open_pipe(0);
+	if(fd < 0 || ring_init(&ring, 2 * batch) < 0) {
+		printf("ringbench: setup failed\n");
+		return 1;
+	}
+
+	for(i = 0; i < batch; i++) data[i] = 'a' + i % 26;
+
+	for(done = 0; done < total; done += n) {
+		n = total - done < batch ? total - done : batch;
+		start = time_nanos();
+		for(i = 0; i < n; i++) syscall_object_write(fd, &data[i], 1, 0);
+		for(i = 0; i < n; i++) syscall_object_read(fd, &back[i], 1, 0);
+		direct_us += (uint32_t) (time_nanos() - start) / 1000;
+		direct_traps += 2 * n;
+	}
+
+	for(done = 0; done < total; done += n) {
+		n = total - done < batch ? total - done : batch;
+		start = time_nanos();
+		for(i = 0; i < n; i++) ring_write(&ring, fd, &data[i], 1, 0, i);
+		for(i = 0; i < n; i++) ring_read(&ring, fd, &back[i], 1, 0, i);
+		ring_submit(&ring);
+		while(ring_complete(&ring, &c)) {
+			if(c.result != 1) {
+				printf("ringbench: operation %d failed: %d\n", c.user_data, c.result);
+				return 1;
+			}
+		}
+		ring_us += (uint32_t) (time_nanos() - start) / 1000;
+		ring_traps++;
+	}
+
+	if(strncmp(data, back, n)) {
+		printf("ringbench: data mismatch\n");
+		return 1;
+	}
+
+	printf("%d one-byte writes and reads in batches of %d:\n", total, batch);
+	printf("  direct: %u us, %d traps\n", direct_us, direct_traps);
+	printf("  ring:   %u us, %d traps\n", ring_us, ring_traps);
+
+	ring_free(&ring);
+	return 0;
+}
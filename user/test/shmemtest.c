@@ -0,0 +1,33 @@
+#include "library/syscalls.h"
+#include "library/string.h"
+
+int main(int argc, char *argv[])
+{
+	printf("%d: Running shared memory test!\n", syscall_process_self());
+	int fd = syscall_open_shmem(4 * PAGE_SIZE);
+	if(fd < 0) {
+		printf("couldn't create shared memory: %d\n", fd);
+		return 1;
+	}
+	char *buf = syscall_object_address(fd);
+	printf("%d: Segment mapped at %x\n", syscall_process_self(), buf);
+	buf[0] = 0;
+	int x = syscall_process_fork();
+	if(x) {
+		printf("%d: Writing...\n", syscall_process_self());
+		strcpy(&buf[1], "Testing!");
+		buf[0] = 1;
+		struct process_info info;
+		syscall_process_wait(&info, -1);
+		printf("%d: Child saw (%s)\n", syscall_process_self(), &buf[3 * PAGE_SIZE]);
+	} else {
+		printf("%d: Reading...\n", syscall_process_self());
+		while(!buf[0]) {
+			syscall_process_yield();
+		}
+		printf("%d: I read (%s) from my brother\n", syscall_process_self(), &buf[1]);
+		strcpy(&buf[3 * PAGE_SIZE], "Received");
+	}
+	syscall_object_close(fd);
+	return 0;
+}
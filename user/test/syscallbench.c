@@ -0,0 +1,62 @@
+#include "library/syscalls.h"
+#include "library/string.h"
+#include "library/time.h"
+
+/*
+Compare the cost of a null system call through the int $48
+gate and through SYSENTER.  Each path runs process_self in a
+tight loop, timed in batches so that each 64-bit difference
+fits in 32 bits before dividing.
+
+Usage: syscallbench [calls]
+*/
+
+#define BATCH 10000
+
+typedef uint32_t (*entry_t)(syscall_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
+
+static uint32_t measure(entry_t entry, int total)
+{
+	uint32_t elapsed_ns = 0;
+	int done = 0;
+	int i;
+
+	while(done < total) {
+		int n = total - done < BATCH ? total - done : BATCH;
+		uint64_t start = time_nanos();
+		for(i = 0; i < n; i++) {
+			entry(SYSCALL_PROCESS_SELF, 0, 0, 0, 0, 0);
+		}
+		elapsed_ns += (uint32_t) (time_nanos() - start) / n;
+		done += n;
+	}
+
+	/* Average of the per-batch averages. */
+	return elapsed_ns / ((total + BATCH - 1) / BATCH);
+}
+
+int main(int argc, char *argv[])
+{
+	int total = 100000;
+	uint32_t edx, eax;
+
+	if(argc > 1) str2int(argv[1], &total);
+	if(total < 1) total = 1;
+
+	if(syscall_trap(SYSCALL_PROCESS_SELF, 0, 0, 0, 0, 0) != syscall_process_self()) {
+		printf("syscallbench: process_self disagrees between entry paths\n");
+		return 1;
+	}
+
+	printf("int $48:  %u ns per call\n", measure(syscall_trap, total));
+
+	asm volatile ("pushl %%ebx; cpuid; popl %%ebx":"=a"(eax), "=d"(edx):"a"(1):"ecx");
+	if(!(edx & (1 << 11))) {
+		printf("sysenter: not supported by this processor\n");
+		return 0;
+	}
+
+	printf("sysenter: %u ns per call\n", measure(syscall_sysenter, total));
+
+	return 0;
+}
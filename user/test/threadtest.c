@@ -0,0 +1,67 @@
+/*
+Start several threads that share a counter under a mutex,
+and allocate from the shared heap, then check the total.
+*/
+
+#include "library/syscalls.h"
+#include "library/string.h"
+#include "library/thread.h"
+#include "library/malloc.h"
+
+#define THREADS 4
+#define ROUNDS 10000
+
+static struct mutex lock = MUTEX_INIT;
+static int counter = 0;
+
+static int worker(void *arg)
+{
+	int id = (int) arg;
+	int i;
+
+	for(i = 0; i < ROUNDS; i++) {
+		mutex_lock(&lock);
+		counter++;
+		mutex_unlock(&lock);
+
+		if(i % 100 == 0) {
+			char *p = malloc(64 + id);
+			memset(p, id, 64 + id);
+			free(p);
+		}
+	}
+
+	return id;
+}
+
+int main(int argc, char *argv[])
+{
+	struct thread *t[THREADS];
+	int i, status, errors = 0;
+
+	for(i = 0; i < THREADS; i++) {
+		t[i] = thread_create(worker, (void *) i);
+		if(!t[i]) {
+			printf("threadtest: couldn't create thread %d\n", i);
+			return 1;
+		}
+	}
+
+	for(i = 0; i < THREADS; i++) {
+		int tid = thread_id(t[i]);
+		if(thread_join(t[i], &status) < 0 || status != i) {
+			printf("threadtest: thread %d returned %d\n", tid, status);
+			errors++;
+		}
+	}
+
+	printf("threadtest: counter %d, expected %d\n", counter, THREADS * ROUNDS);
+
+	if(counter != THREADS * ROUNDS || errors) {
+		printf("threadtest: FAILED\n");
+		return 1;
+	}
+
+	printf("threadtest: passed\n");
+	return 0;
+}
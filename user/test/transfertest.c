@@ -0,0 +1,84 @@
+#include "library/syscalls.h"
+#include "library/string.h"
+#include "library/errno.h"
+
+/*
+Move a file through object_transfer to a pipe, to another file,
+and to the console, checking each against the original data.
+Run in a writable directory.
+*/
+
+#define LENGTH 6000
+
+static char data[LENGTH];
+static char check[LENGTH];
+
+static int open_file(const char *name, int flags)
+{
+	int fd = syscall_open_file(KNO_STDDIR, name, 0, flags);
+	if(fd < 0) printf("transfertest: couldn't open %s: %s\n", name, strerror(fd));
+	return fd;
+}
+
+static int compare(const char *what, int n)
+{
+	int i;
+	if(n != LENGTH) {
+		printf("transfertest: %s moved %d bytes, not %d\n", what, n, LENGTH);
+		return 1;
+	}
+	for(i = 0; i < LENGTH; i++) {
+		if(check[i] != data[i]) {
+			printf("transfertest: %s differs at byte %d\n", what, i);
+			return 1;
+		}
+	}
+	printf("transfertest: %s ok\n", what);
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int i, src, dst, n;
+
+	for(i = 0; i < LENGTH; i++) {
+		data[i] = 'a' + i % 26;
+	}
+
+	dst = open_file("transfer.in", KERNEL_FLAGS_CREATE);
+	if(dst < 0) return 1;
+	syscall_object_write(dst, data, LENGTH, 0);
+	syscall_object_close(dst);
+
+	/* file to pipe, sized so that the whole file fits */
+	src = open_file("transfer.in", 0);
+	dst = syscall_open_pipe(2 * LENGTH);
+	n = syscall_object_transfer(src, dst, LENGTH);
+	syscall_object_read(dst, check, LENGTH, KERNEL_IO_NONBLOCK);
+	syscall_object_close(src);
+	syscall_object_close(dst);
+	if(compare("file to pipe", n)) return 1;
+
+	/* file to file */
+	src = open_file("transfer.in", 0);
+	dst = open_file("transfer.out", KERNEL_FLAGS_CREATE);
+	if(src < 0 || dst < 0) return 1;
+	n = syscall_object_transfer(src, dst, LENGTH);
+	syscall_object_close(src);
+	syscall_object_close(dst);
+	src = open_file("transfer.out", 0);
+	syscall_object_read(src, check, LENGTH, 0);
+	syscall_object_close(src);
+	if(compare("file to file", n)) return 1;
+
+	/* file to console, just the first line's worth */
+	src = open_file("transfer.out", 0);
+	n = syscall_object_transfer(src, KNO_STDOUT, 52);
+	syscall_object_close(src);
+	printf("\ntransfertest: file to console moved %d bytes\n", n);
+
+	syscall_object_remove(KNO_STDDIR, "transfer.in");
+	syscall_object_remove(KNO_STDDIR, "transfer.out");
+
+	return 0;
+}